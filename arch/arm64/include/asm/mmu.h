@@ -16,10 +16,13 @@
 #ifndef __ASM_MMU_H
 #define __ASM_MMU_H
 
+#include <linux/refcount.h>
+
 #define MMCF_AARCH32	0x1	/* mm context flag for AArch32 executables */
 
 typedef struct {
 	atomic64_t	id;
+	refcount_t	pinned;
 	void		*vdso;
 	unsigned long	flags;
 } mm_context_t;
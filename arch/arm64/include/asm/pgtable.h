@@ -234,8 +234,8 @@ extern void __sync_icache_dcache(pte_t pteval, unsigned long addr);
  *
  *   PTE_DIRTY || (PTE_WRITE && !PTE_RDONLY)
  */
-static inline void set_pte_at(struct mm_struct *mm, unsigned long addr,
-			      pte_t *ptep, pte_t pte)
+static inline void __set_pte_at(struct mm_struct *mm, unsigned long addr,
+				pte_t *ptep, pte_t pte)
 {
 	if (pte_present(pte) && pte_user_exec(pte) && !pte_special(pte))
 		__sync_icache_dcache(pte, addr);
@@ -258,6 +258,62 @@ static inline void set_pte_at(struct mm_struct *mm, unsigned long addr,
 	set_pte(ptep, pte);
 }
 
+/*
+ * Contiguous user mappings.
+ *
+ * set_pte_at() sets PTE_CONT on a naturally aligned range of CONT_PTES user
+ * entries once they all map consecutive pages with the same attributes, and
+ * the hardware has no access flag or dirty state left to update in any of
+ * them. Folded entries therefore stay identical apart from their output
+ * address, and reading any one of them gives the state of that page.
+ *
+ * Any change to an entry of a folded range unfolds the whole range first
+ * (break-before-make, see the "Misprogramming of the Contiguous bit" section
+ * of the ARM ARM). The caller must hold the page table lock, which covers the
+ * whole range.
+ *
+ * Block entries and hugetlb pages use the __ variants, which never fold or
+ * unfold anything.
+ */
+extern void __contpte_try_fold(struct mm_struct *mm, unsigned long addr,
+			       pte_t *ptep, pte_t pte);
+extern void __contpte_unfold(struct mm_struct *mm, unsigned long addr,
+			     pte_t *ptep);
+
+#define pte_valid_cont(pte)	(pte_valid(pte) && pte_cont(pte))
+
+static inline bool contpte_foldable(unsigned long addr, pte_t pte)
+{
+	if (!pte_valid(pte) || pte_valid_not_user(pte) || pte_special(pte))
+		return false;
+
+	/* The hardware may still set PTE_AF or clear PTE_RDONLY */
+	if (!pte_young(pte) || (pte_write(pte) && !pte_hw_dirty(pte)))
+		return false;
+
+	return !((pte_pfn(pte) ^ (addr >> PAGE_SHIFT)) & (CONT_PTES - 1));
+}
+
+static inline void contpte_try_unfold(struct mm_struct *mm,
+				      unsigned long addr, pte_t *ptep)
+{
+	if (unlikely(pte_valid_cont(READ_ONCE(*ptep))))
+		__contpte_unfold(mm, addr, ptep);
+}
+
+static inline void set_pte_at(struct mm_struct *mm, unsigned long addr,
+			      pte_t *ptep, pte_t pte)
+{
+	contpte_try_unfold(mm, addr, ptep);
+
+	if (pte_valid(pte))
+		pte = pte_mknoncont(pte);
+	__set_pte_at(mm, addr, ptep, pte);
+
+	if (contpte_foldable(addr, pte))
+		__contpte_try_fold(mm, addr, ptep, pte);
+}
+
 #define __HAVE_ARCH_PTE_SAME
 static inline int pte_same(pte_t pte_a, pte_t pte_b)
 {
@@ -267,10 +323,10 @@ static inline int pte_same(pte_t pte_a, pte_t pte_b)
 	rhs = pte_val(pte_b);
 
 	if (pte_present(pte_a))
-		lhs &= ~PTE_RDONLY;
+		lhs &= ~(PTE_RDONLY | PTE_CONT);
 
 	if (pte_present(pte_b))
-		rhs &= ~PTE_RDONLY;
+		rhs &= ~(PTE_RDONLY | PTE_CONT);
 
 	return (lhs == rhs);
 }
@@ -364,7 +420,7 @@ static inline int pmd_protnone(pmd_t pmd)
 #define pud_write(pud)		pte_write(pud_pte(pud))
 #define pud_pfn(pud)		(((pud_val(pud) & PUD_MASK) & PHYS_MASK) >> PAGE_SHIFT)
 
-#define set_pmd_at(mm, addr, pmdp, pmd)	set_pte_at(mm, addr, (pte_t *)pmdp, pmd_pte(pmd))
+#define set_pmd_at(mm, addr, pmdp, pmd)	__set_pte_at(mm, addr, (pte_t *)pmdp, pmd_pte(pmd))
 
 #define __pgprot_modify(prot,mask,bits) \
 	__pgprot((pgprot_val(prot) & ~(mask)) | (bits))
@@ -581,10 +637,21 @@ static inline pmd_t pmd_modify(pmd_t pmd, pgprot_t newprot)
 	return pte_pmd(pte_modify(pmd_pte(pmd), newprot));
 }
 
+extern int __ptep_set_access_flags(struct vm_area_struct *vma,
+				   unsigned long address, pte_t *ptep,
+				   pte_t entry, int dirty);
+
 #define __HAVE_ARCH_PTEP_SET_ACCESS_FLAGS
-extern int ptep_set_access_flags(struct vm_area_struct *vma,
-				 unsigned long address, pte_t *ptep,
-				 pte_t entry, int dirty);
+static inline int ptep_set_access_flags(struct vm_area_struct *vma,
+					unsigned long address, pte_t *ptep,
+					pte_t entry, int dirty)
+{
+	pte_t pte = READ_ONCE(*ptep);
+
+	if (unlikely(pte_valid_cont(pte)) && !pte_same(pte, entry))
+		__contpte_unfold(vma->vm_mm, address, ptep);
+	return __ptep_set_access_flags(vma, address, ptep, entry, dirty);
+}
 
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 #define __HAVE_ARCH_PMDP_SET_ACCESS_FLAGS
@@ -592,7 +659,8 @@ static inline int pmdp_set_access_flags(struct vm_area_struct *vma,
 					unsigned long address, pmd_t *pmdp,
 					pmd_t entry, int dirty)
 {
-	return ptep_set_access_flags(vma, address, (pte_t *)pmdp, pmd_pte(entry), dirty);
+	return __ptep_set_access_flags(vma, address, (pte_t *)pmdp,
+				       pmd_pte(entry), dirty);
 }
 #endif
 
@@ -619,6 +687,7 @@ static inline int ptep_test_and_clear_young(struct vm_area_struct *vma,
 					    unsigned long address,
 					    pte_t *ptep)
 {
+	contpte_try_unfold(vma->vm_mm, address, ptep);
 	return __ptep_test_and_clear_young(ptep);
 }
 
@@ -628,15 +697,22 @@ static inline int pmdp_test_and_clear_young(struct vm_area_struct *vma,
 					    unsigned long address,
 					    pmd_t *pmdp)
 {
-	return ptep_test_and_clear_young(vma, address, (pte_t *)pmdp);
+	return __ptep_test_and_clear_young((pte_t *)pmdp);
 }
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE */
 
+static inline pte_t __ptep_get_and_clear(struct mm_struct *mm,
+					 unsigned long address, pte_t *ptep)
+{
+	return __pte(xchg_relaxed(&pte_val(*ptep), 0));
+}
+
 #define __HAVE_ARCH_PTEP_GET_AND_CLEAR
 static inline pte_t ptep_get_and_clear(struct mm_struct *mm,
 				       unsigned long address, pte_t *ptep)
 {
-	return __pte(xchg_relaxed(&pte_val(*ptep), 0));
+	contpte_try_unfold(mm, address, ptep);
+	return __ptep_get_and_clear(mm, address, ptep);
 }
 
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
@@ -644,7 +720,7 @@ static inline pte_t ptep_get_and_clear(struct mm_struct *mm,
 static inline pmd_t pmdp_huge_get_and_clear(struct mm_struct *mm,
 					    unsigned long address, pmd_t *pmdp)
 {
-	return pte_pmd(ptep_get_and_clear(mm, address, (pte_t *)pmdp));
+	return pte_pmd(__ptep_get_and_clear(mm, address, (pte_t *)pmdp));
 }
 #endif /* CONFIG_TRANSPARENT_HUGEPAGE */
 
@@ -652,8 +728,8 @@ static inline pmd_t pmdp_huge_get_and_clear(struct mm_struct *mm,
  * ptep_set_wrprotect - mark read-only while trasferring potential hardware
  * dirty status (PTE_DBM && !PTE_RDONLY) to the software PTE_DIRTY bit.
  */
-#define __HAVE_ARCH_PTEP_SET_WRPROTECT
-static inline void ptep_set_wrprotect(struct mm_struct *mm, unsigned long address, pte_t *ptep)
+static inline void __ptep_set_wrprotect(struct mm_struct *mm,
+					unsigned long address, pte_t *ptep)
 {
 	pte_t old_pte, pte;
 
@@ -672,12 +748,20 @@ static inline void ptep_set_wrprotect(struct mm_struct *mm, unsigned long addres
 	} while (pte_val(pte) != pte_val(old_pte));
 }
 
+#define __HAVE_ARCH_PTEP_SET_WRPROTECT
+static inline void ptep_set_wrprotect(struct mm_struct *mm,
+				      unsigned long address, pte_t *ptep)
+{
+	contpte_try_unfold(mm, address, ptep);
+	__ptep_set_wrprotect(mm, address, ptep);
+}
+
 #ifdef CONFIG_TRANSPARENT_HUGEPAGE
 #define __HAVE_ARCH_PMDP_SET_WRPROTECT
 static inline void pmdp_set_wrprotect(struct mm_struct *mm,
 				      unsigned long address, pmd_t *pmdp)
 {
-	ptep_set_wrprotect(mm, address, (pte_t *)pmdp);
+	__ptep_set_wrprotect(mm, address, (pte_t *)pmdp);
 }
 #endif
 
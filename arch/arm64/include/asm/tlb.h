@@ -33,8 +33,39 @@ static inline void __tlb_remove_table(void *_table)
 #define tlb_remove_entry(tlb, entry)	tlb_remove_page(tlb, entry)
 #endif /* CONFIG_HAVE_RCU_TABLE_FREE */
 
+#define tlb_remove_check_page_size_change tlb_remove_check_page_size_change
+
 #include <asm-generic/tlb.h>
 
+/*
+ * Keep tlb->page_size valid for the whole gathered range, flushing when
+ * it changes, so that tlb_flush() can pick the TLBI stride from it.
+ */
+static inline void tlb_remove_check_page_size_change(struct mmu_gather *tlb,
+						     unsigned int page_size)
+{
+	if (!tlb->page_size)
+		tlb->page_size = page_size;
+	else if (tlb->page_size != page_size) {
+		if (!tlb->fullmm)
+			tlb_flush_mmu(tlb);
+		tlb->page_size = page_size;
+	}
+}
+
+/*
+ * A PMD stride is only safe when every entry in the range was a block
+ * mapping. arch_tlb_finish_mmu() clears page_size before widening the
+ * range for a nested flush, which falls back to PAGE_SIZE here.
+ */
+static inline unsigned long tlb_get_unmap_stride(struct mmu_gather *tlb)
+{
+	/* PUD and contiguous PMD mappings are still hit every PMD_SIZE */
+	if (tlb->page_size >= PMD_SIZE)
+		return PMD_SIZE;
+	return PAGE_SIZE;
+}
+
 static inline void tlb_flush(struct mmu_gather *tlb)
 {
 	struct vm_area_struct vma = { .vm_mm = tlb->mm, };
@@ -51,7 +82,8 @@ static inline void tlb_flush(struct mmu_gather *tlb)
 	 * the __(pte|pmd|pud)_free_tlb() functions, so last level
 	 * TLBI is sufficient here.
 	 */
-	__flush_tlb_range(&vma, tlb->start, tlb->end, true);
+	__flush_tlb_range(&vma, tlb->start, tlb->end,
+			  tlb_get_unmap_stride(tlb), true);
 }
 
 static inline void __pte_free_tlb(struct mmu_gather *tlb, pgtable_t pte,
@@ -80,6 +80,18 @@ static bool __kprobes aarch64_insn_is_steppable(u32 insn)
 enum probe_insn __kprobes
 arm_probe_decode_insn(probe_opcode_t insn, struct arch_probe_insn *api)
 {
+	/*
+	 * NOPs are steppable, but compilers put them at function entries
+	 * for patching, which is where probes usually land. Simulating them
+	 * saves the XOL slot and the single-step exception on every hit.
+	 * Only a real NOP can be simulated as nothing; the other steppable
+	 * hints (ESB, PSB CSYNC, CSDB, ...) still have to execute.
+	 */
+	if (insn == aarch64_insn_gen_hint(AARCH64_INSN_HINT_NOP)) {
+		api->handler = simulate_nop;
+		return INSN_GOOD_NO_SLOT;
+	}
+
 	/*
 	 * Instructions reading or modifying the PC won't work from the XOL
 	 * slot.
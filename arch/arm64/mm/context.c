@@ -18,7 +18,9 @@
  */
 
 #include <linux/bitops.h>
+#include <linux/debugfs.h>
 #include <linux/sched.h>
+#include <linux/sched/clock.h>
 #include <linux/slab.h>
 #include <linux/mm.h>
 
@@ -37,6 +39,15 @@ static DEFINE_PER_CPU(atomic64_t, active_asids);
 static DEFINE_PER_CPU(u64, reserved_asids);
 static cpumask_t tlb_flush_pending;
 
+static unsigned long max_pinned_asids;
+static unsigned long nr_pinned_asids;
+static unsigned long *pinned_asid_map;
+
+/* Statistics, updated under cpu_asid_lock */
+static u64 asid_rollovers;
+static u64 asid_slowpath_switches;
+static u64 asid_lock_wait_ns;
+
 #define ASID_MASK		(~GENMASK(asid_bits - 1, 0))
 #define ASID_FIRST_VERSION	(1UL << asid_bits)
 #define NUM_USER_ASIDS		ASID_FIRST_VERSION
@@ -91,8 +102,14 @@ static void flush_context(unsigned int cpu)
 	int i;
 	u64 asid;
 
-	/* Update the list of reserved ASIDs and the ASID bitmap. */
-	bitmap_clear(asid_map, 0, NUM_USER_ASIDS);
+	/*
+	 * Update the list of reserved ASIDs and the ASID bitmap. Pinned
+	 * ASIDs stay allocated across generations.
+	 */
+	if (pinned_asid_map)
+		bitmap_copy(asid_map, pinned_asid_map, NUM_USER_ASIDS);
+	else
+		bitmap_clear(asid_map, 0, NUM_USER_ASIDS);
 
 	set_reserved_asid_bits();
 
@@ -158,6 +175,14 @@ static u64 new_context(struct mm_struct *mm, unsigned int cpu)
 		if (check_update_reserved_asid(asid, newasid))
 			return newasid;
 
+		/*
+		 * If it is pinned, we can keep using it. Note that reserved
+		 * takes priority, because even if it is also pinned, we need to
+		 * update the generation into the reserved_asids.
+		 */
+		if (refcount_read(&mm->context.pinned))
+			return newasid;
+
 		/*
 		 * We had a valid ASID in a previous life, so try to re-use
 		 * it if possible.
@@ -181,6 +206,7 @@ static u64 new_context(struct mm_struct *mm, unsigned int cpu)
 	generation = atomic64_add_return_relaxed(ASID_FIRST_VERSION,
 						 &asid_generation);
 	flush_context(cpu);
+	asid_rollovers++;
 
 	/* We have more ASIDs than CPUs, so this will always succeed */
 	asid = find_next_zero_bit(asid_map, NUM_USER_ASIDS, 1);
@@ -194,7 +220,7 @@ static u64 new_context(struct mm_struct *mm, unsigned int cpu)
 void check_and_switch_context(struct mm_struct *mm, unsigned int cpu)
 {
 	unsigned long flags;
-	u64 asid;
+	u64 asid, wait_start;
 
 	asid = atomic64_read(&mm->context.id);
 
@@ -216,7 +242,11 @@ void check_and_switch_context(struct mm_struct *mm, unsigned int cpu)
 	    && atomic64_xchg_relaxed(&per_cpu(active_asids, cpu), asid))
 		goto switch_mm_fastpath;
 
+	wait_start = local_clock();
 	raw_spin_lock_irqsave(&cpu_asid_lock, flags);
+	asid_lock_wait_ns += local_clock() - wait_start;
+	asid_slowpath_switches++;
+
 	/* Check that our ASID belongs to the current generation. */
 	asid = atomic64_read(&mm->context.id);
 	if ((asid ^ atomic64_read(&asid_generation)) >> asid_bits) {
@@ -239,6 +269,70 @@ void check_and_switch_context(struct mm_struct *mm, unsigned int cpu)
 		cpu_switch_mm(mm->pgd, mm);
 }
 
+/*
+ * Pin the ASID of @mm, so that it survives rollovers. This is for users
+ * that cannot follow ASID changes, such as a device sharing the page
+ * tables. Returns the ASID, or 0 if no more ASIDs can be pinned.
+ */
+unsigned long arm64_mm_context_get(struct mm_struct *mm)
+{
+	unsigned long flags;
+	u64 asid;
+
+	if (!pinned_asid_map)
+		return 0;
+
+	raw_spin_lock_irqsave(&cpu_asid_lock, flags);
+
+	asid = atomic64_read(&mm->context.id);
+
+	if (refcount_inc_not_zero(&mm->context.pinned))
+		goto out_unlock;
+
+	if (nr_pinned_asids >= max_pinned_asids) {
+		asid = 0;
+		goto out_unlock;
+	}
+
+	if ((asid ^ atomic64_read(&asid_generation)) >> asid_bits) {
+		/*
+		 * We went through one or more rollover since that ASID was
+		 * used. Ensure that it is still valid, or generate a new one.
+		 */
+		asid = new_context(mm, smp_processor_id());
+		atomic64_set(&mm->context.id, asid);
+	}
+
+	nr_pinned_asids++;
+	__set_bit(asid & ~ASID_MASK, pinned_asid_map);
+	refcount_set(&mm->context.pinned, 1);
+
+out_unlock:
+	raw_spin_unlock_irqrestore(&cpu_asid_lock, flags);
+
+	return asid & ~ASID_MASK;
+}
+EXPORT_SYMBOL_GPL(arm64_mm_context_get);
+
+void arm64_mm_context_put(struct mm_struct *mm)
+{
+	unsigned long flags;
+	u64 asid = atomic64_read(&mm->context.id);
+
+	if (!pinned_asid_map)
+		return;
+
+	raw_spin_lock_irqsave(&cpu_asid_lock, flags);
+
+	if (refcount_dec_and_test(&mm->context.pinned)) {
+		__clear_bit(asid & ~ASID_MASK, pinned_asid_map);
+		nr_pinned_asids--;
+	}
+
+	raw_spin_unlock_irqrestore(&cpu_asid_lock, flags);
+}
+EXPORT_SYMBOL_GPL(arm64_mm_context_put);
+
 static int asids_init(void)
 {
 	asid_bits = get_cpu_asid_bits();
@@ -254,9 +348,37 @@ static int asids_init(void)
 		panic("Failed to allocate bitmap for %lu ASIDs\n",
 		      NUM_USER_ASIDS);
 
+	pinned_asid_map = kzalloc(BITS_TO_LONGS(NUM_USER_ASIDS) *
+				  sizeof(*pinned_asid_map), GFP_KERNEL);
+	nr_pinned_asids = 0;
+
+	/*
+	 * We cannot pin more ASIDs than the number of available ASIDs minus
+	 * all the CPUs (to ensure rollover works), minus 1 for reserved ASID
+	 * #0 and minus 1 for a possible erratum-reserved ASID.
+	 */
+	max_pinned_asids = NUM_USER_ASIDS - num_possible_cpus() - 2;
+
 	set_reserved_asid_bits();
 
 	pr_info("ASID allocator initialised with %lu entries\n", NUM_USER_ASIDS);
 	return 0;
 }
 early_initcall(asids_init);
+
+static int __init asids_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("asid", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_u64("rollovers", 0400, dir, &asid_rollovers);
+	debugfs_create_u64("slowpath_switches", 0400, dir,
+			   &asid_slowpath_switches);
+	debugfs_create_u64("lock_wait_ns", 0400, dir, &asid_lock_wait_ns);
+	debugfs_create_ulong("pinned", 0400, dir, &nr_pinned_asids);
+	return 0;
+}
+late_initcall(asids_debugfs_init);
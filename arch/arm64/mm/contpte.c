@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Contiguous PTE ranges for user memory
+ *
+ * See the comment above set_pte_at() in asm/pgtable.h.
+ */
+#include <linux/export.h>
+#include <linux/mm.h>
+
+#include <asm/pgtable.h>
+#include <asm/tlbflush.h>
+
+/* Output address bits of a page entry */
+#define PTE_OA_MASK	(PHYS_MASK & PAGE_MASK)
+
+/*
+ * The break step of break-before-make: clear all entries of the range
+ * starting at @ptep and flush them from the TLB.
+ */
+static void contpte_clear_flush(struct mm_struct *mm, unsigned long addr,
+				pte_t *ptep)
+{
+	struct vm_area_struct vma = { .vm_mm = mm };
+	int i;
+
+	for (i = 0; i < CONT_PTES; i++)
+		pte_clear(mm, addr + i * PAGE_SIZE, ptep + i);
+
+	__flush_tlb_range(&vma, addr, addr + CONT_PTE_SIZE, PAGE_SIZE, true);
+}
+
+/*
+ * @pte has just been written to @ptep. Fold the range it belongs to if all
+ * of its entries now map consecutive pages, starting at a naturally aligned
+ * one, with the same attributes as @pte.
+ */
+void __contpte_try_fold(struct mm_struct *mm, unsigned long addr,
+			pte_t *ptep, pte_t pte)
+{
+	unsigned long pfn = pte_pfn(pte) - CONT_RANGE_OFFSET(addr);
+	pgprot_t prot = __pgprot(pte_val(pte) & ~PTE_OA_MASK);
+	int i;
+
+	ptep -= CONT_RANGE_OFFSET(addr);
+	addr &= CONT_PTE_MASK;
+
+	for (i = 0; i < CONT_PTES; i++)
+		if (pte_val(READ_ONCE(ptep[i])) !=
+		    pte_val(pfn_pte(pfn + i, prot)))
+			return;
+
+	contpte_clear_flush(mm, addr, ptep);
+
+	for (i = 0; i < CONT_PTES; i++)
+		set_pte(ptep + i, pte_mkcont(pfn_pte(pfn + i, prot)));
+}
+EXPORT_SYMBOL(__contpte_try_fold);
+
+/*
+ * Rewrite the folded range that @ptep belongs to without PTE_CONT. The
+ * entries of a folded range only differ in their output address, so all
+ * of them can be rebuilt from the first one.
+ */
+void __contpte_unfold(struct mm_struct *mm, unsigned long addr, pte_t *ptep)
+{
+	unsigned long pfn;
+	pgprot_t prot;
+	pte_t pte;
+	int i;
+
+	ptep -= CONT_RANGE_OFFSET(addr);
+	addr &= CONT_PTE_MASK;
+
+	pte = pte_mknoncont(READ_ONCE(*ptep));
+	pfn = pte_pfn(pte);
+	prot = __pgprot(pte_val(pte) & ~PTE_OA_MASK);
+
+	contpte_clear_flush(mm, addr, ptep);
+
+	for (i = 0; i < CONT_PTES; i++)
+		set_pte(ptep + i, pfn_pte(pfn + i, prot));
+}
+EXPORT_SYMBOL(__contpte_unfold);
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Test the arm64 ASID pinning API
+ *
+ * Pin the ASID of the task loading the module, then move that task
+ * across all online CPUs and check that every context switch keeps
+ * the pinned ASID.
+ */
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/cpumask.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+
+#include <asm/mmu_context.h>
+
+static unsigned int total_tests __initdata;
+static unsigned int failed_tests __initdata;
+
+#define expect_eq(x, y, fmt)						\
+({									\
+	typeof(x) __x = (x);						\
+	typeof(y) __y = (y);						\
+									\
+	total_tests++;							\
+	if (__x != __y) {						\
+		pr_warn("%s:%d: expected " fmt ", got " fmt "\n",	\
+			__func__, __LINE__, __y, __x);			\
+		failed_tests++;						\
+	}								\
+})
+
+static int __init test_asid_pin_init(void)
+{
+	struct mm_struct *mm = current->mm;
+	unsigned long asid;
+	cpumask_var_t saved;
+	int cpu;
+
+	if (!mm)
+		return -EINVAL;
+	if (!alloc_cpumask_var(&saved, GFP_KERNEL))
+		return -ENOMEM;
+	cpumask_copy(saved, &current->cpus_allowed);
+
+	asid = arm64_mm_context_get(mm);
+	if (!asid) {
+		pr_warn("cannot pin an ASID\n");
+		free_cpumask_var(saved);
+		return -ENOSPC;
+	}
+
+	/* A second pin only takes a reference */
+	expect_eq(arm64_mm_context_get(mm), asid, "%lu");
+	arm64_mm_context_put(mm);
+	expect_eq((unsigned long)refcount_read(&mm->context.pinned), 1UL,
+		  "%lu");
+
+	for_each_online_cpu(cpu) {
+		if (set_cpus_allowed_ptr(current, cpumask_of(cpu)))
+			continue;
+		expect_eq((int)raw_smp_processor_id(), cpu, "%d");
+		expect_eq((unsigned long)ASID(mm), asid, "%lu");
+	}
+
+	set_cpus_allowed_ptr(current, saved);
+	free_cpumask_var(saved);
+
+	arm64_mm_context_put(mm);
+	expect_eq((unsigned long)refcount_read(&mm->context.pinned), 0UL,
+		  "%lu");
+
+	if (failed_tests == 0)
+		pr_info("all %u tests passed\n", total_tests);
+	else
+		pr_warn("failed %u out of %u tests\n",
+			failed_tests, total_tests);
+
+	return failed_tests ? -EINVAL : 0;
+}
+
+static void __exit test_asid_pin_cleanup(void)
+{
+}
+
+module_init(test_asid_pin_init);
+module_exit(test_asid_pin_cleanup);
+
+MODULE_LICENSE("GPL");
@@ -712,9 +712,11 @@ static int branch_setup_xol_ops(struct arch_uprobe *auprobe, struct insn *insn)
 	switch (opc1) {
 	case 0xeb:	/* jmp 8 */
 	case 0xe9:	/* jmp 32 */
-	case 0x90:	/* prefix* + nop; same as jmp with .offs = 0 */
 		break;
 
+	case 0x90:	/* prefix* + nop; same as jmp with .offs = 0 */
+		goto setup;
+
 	case 0xe8:	/* call relative */
 		branch_clear_offset(auprobe, insn);
 		break;
@@ -722,6 +724,16 @@ static int branch_setup_xol_ops(struct arch_uprobe *auprobe, struct insn *insn)
 	case 0x0f:
 		if (insn->opcode.nbytes != 2)
 			return -ENOSYS;
+		/*
+		 * "nop Ev" is what compilers emit to pad function entries,
+		 * which is exactly where most uprobes are placed. Like 0x90
+		 * it only advances ->ip, so emulate it as a jmp with .offs = 0.
+		 * The 66 prefix is harmless here, nopw is the common 6-byte nop.
+		 */
+		if (OPCODE2(insn) == 0x1f) {
+			opc1 = 0x90;
+			goto setup;
+		}
 		/*
 		 * If it is a "near" conditional jmp, OPCODE2() - 0x10 matches
 		 * OPCODE1() of the "short" jmp which checks the same condition.
@@ -742,6 +754,7 @@ static int branch_setup_xol_ops(struct arch_uprobe *auprobe, struct insn *insn)
 			return -ENOTSUPP;
 	}
 
+setup:
 	auprobe->branch.opc1 = opc1;
 	auprobe->branch.ilen = insn->length;
 	auprobe->branch.offs = insn->immediate.value;
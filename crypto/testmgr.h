@@ -34495,6 +34495,68 @@ static const struct hash_testvec crc32c_tv_template[] = {
 	}
 };
 
+/*
+ * xxhash64 test vectors
+ *
+ * testmgr reuses one tfm for all vectors, so the unkeyed ones set the
+ * default zero seed explicitly.
+ */
+static const struct hash_testvec xxhash64_tv_template[] = {
+	{
+		.key = "\x00\x00\x00\x00\x00\x00\x00\x00",
+		.ksize = 8,
+		.psize = 0,
+		.digest = "\x99\xe9\xd8\x51\x37\xdb\x46\xef",
+	},
+	{
+		.key = "\x00\x00\x00\x00\x00\x00\x00\x00",
+		.ksize = 8,
+		.plaintext = "\x40",
+		.psize = 1,
+		.digest = "\x20\x5c\x91\xaa\x88\xeb\x59\xd0",
+	},
+	{
+		.key = "\x00\x00\x00\x00\x00\x00\x00\x00",
+		.ksize = 8,
+		.plaintext = "\x01\x02\x03\x04\x05\x06\x07\x08"
+			     "\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10"
+			     "\x11\x12\x13\x14\x15\x16\x17\x18"
+			     "\x19\x1a\x1b\x1c\x1d\x1e\x1f\x20"
+			     "\x21\x22\x23\x24\x25\x26\x27\x28",
+		.psize = 40,
+		.digest = "\xa3\x80\x97\xd6\x85\x01\xd7\xba",
+	},
+	{
+		.key = "\xb1\x79\x37\x9e\x00\x00\x00\x00",
+		.ksize = 8,
+		.plaintext = "\x29\x2a\x2b\x2c\x2d\x2e\x2f\x30"
+			     "\x31\x32\x33\x34\x35\x36\x37\x38"
+			     "\x39\x3a\x3b\x3c\x3d\x3e\x3f\x40"
+			     "\x41\x42\x43\x44\x45\x46\x47\x48"
+			     "\x49\x4a\x4b\x4c\x4d\x4e\x4f\x50"
+			     "\x51\x52\x53\x54\x55\x56\x57\x58"
+			     "\x59\x5a\x5b\x5c\x5d\x5e\x5f\x60"
+			     "\x61\x62\x63\x64\x65\x66\x67\x68"
+			     "\x69\x6a\x6b\x6c\x6d\x6e\x6f\x70",
+		.psize = 72,
+		.digest = "\xf8\x24\xb1\xc3\x0d\x42\xb1\xb0",
+	},
+	{
+		.key = "\x00\x00\x00\x00\x00\x00\x00\x00",
+		.ksize = 8,
+		.plaintext = "\x0b\x30\x55\x7a\x9f\xc4\xe9\x0e"
+			     "\x33\x58\x7d\xa2\xc7\xec\x11\x36"
+			     "\x5b\x80\xa5\xca\xef\x14\x39\x5e"
+			     "\x83\xa8\xcd\xf2\x17\x3c\x61\x86"
+			     "\xab\xd0\xf5\x1a\x3f\x64\x89\xae"
+			     "\xd3\xf8\x1d\x42\x67\x8c\xb1\xd6"
+			     "\xfb\x20\x45\x6a\x8f\xb4\xd9\xfe"
+			     "\x23\x48\x6d\x92\xb7\xdc\x01\x26",
+		.psize = 64,
+		.digest = "\xfc\xbe\x32\xbf\xe4\xcc\x5c\x15",
+	},
+};
+
 /*
  * Blakcifn CRC test vectors
  */
@@ -120,6 +120,13 @@ struct bpf_insn_aux_data {
 
 #define MAX_USED_MAPS 64 /* max number of maps accessed by one eBPF program */
 
+/* Maximum number of register states that can exist at once */
+#define BPF_ID_MAP_SIZE (MAX_BPF_REG + MAX_BPF_STACK / BPF_REG_SIZE)
+struct bpf_id_pair {
+	u32 old;
+	u32 cur;
+};
+
 #define BPF_VERIFIER_TMP_LOG_SIZE	1024
 
 struct bpf_verifer_log {
@@ -161,6 +168,15 @@ struct bpf_verifier_env {
 	struct bpf_insn_aux_data *insn_aux_data; /* array of per-insn state */
 
 	struct bpf_verifer_log log;
+	struct bpf_id_pair idmap_scratch[BPF_ID_MAP_SIZE];
+
+	/* verification statistics, reported in the log */
+	u32 insn_processed;		/* instructions walked by do_check() */
+	u32 total_states;		/* states saved for pruning */
+	u32 pruned_states;		/* branches cut short by a saved state */
+	u32 peak_states;		/* max saved + pending states at once */
+	u32 max_states_per_insn;	/* longest explored_states list */
+	u64 verification_time;		/* in ns */
 };
 
 static inline struct bpf_reg_state *cur_regs(struct bpf_verifier_env *env)
@@ -719,6 +719,11 @@ struct perf_event_context {
 	int				nr_stat;
 	int				nr_freq;
 	int				rotate_disable;
+	/*
+	 * Set when a flexible group could not be scheduled, which is
+	 * the only case where rotating the flexible groups helps.
+	 */
+	int				rotate_necessary;
 	atomic_t			refcount;
 	struct task_struct		*task;
 
@@ -762,6 +767,7 @@ struct perf_cpu_context {
 	struct hrtimer			hrtimer;
 	ktime_t				hrtimer_interval;
 	unsigned int			hrtimer_active;
+	u64				nr_rotations;
 
 #ifdef CONFIG_CGROUP_PERF
 	struct perf_cgroup		*cgrp;
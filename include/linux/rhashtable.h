@@ -129,6 +129,9 @@ struct rhashtable;
  * @min_size: Minimum size while shrinking
  * @locks_mul: Number of bucket locks to allocate per cpu (default: 32)
  * @automatic_shrinking: Enable automatic shrinking of tables
+ * @grow_threshold: Load in percent above which the table grows (default: 75)
+ * @shrink_threshold: Load in percent below which the table automatically
+ *	shrinks (default: 30)
  * @nulls_base: Base value to generate nulls marker
  * @hashfn: Hash function (default: jhash2 if !(key_len % 4), or jhash)
  * @obj_hashfn: Function to hash object
@@ -143,6 +146,8 @@ struct rhashtable_params {
 	u16			min_size;
 	bool			automatic_shrinking;
 	u8			locks_mul;
+	u8			grow_threshold;
+	u8			shrink_threshold;
 	u32			nulls_base;
 	rht_hashfn_t		hashfn;
 	rht_obj_hashfn_t	obj_hashfn;
@@ -160,6 +165,8 @@ struct rhashtable_params {
  * @run_work: Deferred worker to expand/shrink asynchronously
  * @mutex: Mutex to protect current/future table swapping
  * @lock: Spin lock to protect walker list
+ * @rehashes: Number of completed rehashes, protected by @mutex
+ * @rehash_ns: Time spent moving entries during rehashes, protected by @mutex
  */
 struct rhashtable {
 	struct bucket_table __rcu	*tbl;
@@ -171,6 +178,26 @@ struct rhashtable {
 	struct work_struct		run_work;
 	struct mutex                    mutex;
 	spinlock_t			lock;
+	unsigned int			rehashes;
+	u64				rehash_ns;
+};
+
+/**
+ * struct rhashtable_stats - Hash table statistics
+ * @nelems: Number of elements in table
+ * @size: Number of buckets in the current table
+ * @used_buckets: Number of non-empty buckets in the current table
+ * @max_chain: Length of the longest chain in the current table
+ * @rehashes: Number of completed rehashes
+ * @rehash_ns: Time spent moving entries during rehashes
+ */
+struct rhashtable_stats {
+	unsigned int	nelems;
+	unsigned int	size;
+	unsigned int	used_buckets;
+	unsigned int	max_chain;
+	unsigned int	rehashes;
+	u64		rehash_ns;
 };
 
 /**
@@ -284,28 +311,34 @@ static inline unsigned int rht_head_hashfn(
 }
 
 /**
- * rht_grow_above_75 - returns true if nelems > 0.75 * table-size
+ * rht_grow_above_75 - returns true if nelems > grow_threshold% of table-size
  * @ht:		hash table
  * @tbl:	current table
+ *
+ * The threshold is 75% unless the user configured another one.
  */
 static inline bool rht_grow_above_75(const struct rhashtable *ht,
 				     const struct bucket_table *tbl)
 {
-	/* Expand table when exceeding 75% load */
-	return atomic_read(&ht->nelems) > (tbl->size / 4 * 3) &&
+	/* Expand table when exceeding the grow threshold */
+	return (u64)atomic_read(&ht->nelems) * 100 >
+	       (u64)tbl->size * ht->p.grow_threshold &&
 	       (!ht->p.max_size || tbl->size < ht->p.max_size);
 }
 
 /**
- * rht_shrink_below_30 - returns true if nelems < 0.3 * table-size
+ * rht_shrink_below_30 - returns true if nelems < shrink_threshold% of table-size
  * @ht:		hash table
  * @tbl:	current table
+ *
+ * The threshold is 30% unless the user configured another one.
  */
 static inline bool rht_shrink_below_30(const struct rhashtable *ht,
 				       const struct bucket_table *tbl)
 {
-	/* Shrink table beneath 30% load */
-	return atomic_read(&ht->nelems) < (tbl->size * 3 / 10) &&
+	/* Shrink table beneath the shrink threshold */
+	return (u64)atomic_read(&ht->nelems) * 100 <
+	       (u64)tbl->size * ht->p.shrink_threshold &&
 	       tbl->size > ht->p.min_size;
 }
 
@@ -387,6 +420,9 @@ void rhashtable_free_and_destroy(struct rhashtable *ht,
 				 void *arg);
 void rhashtable_destroy(struct rhashtable *ht);
 
+void rhashtable_get_stats(struct rhashtable *ht,
+			  struct rhashtable_stats *stats);
+
 struct rhash_head __rcu **rht_bucket_nested(const struct bucket_table *tbl,
 					    unsigned int hash);
 struct rhash_head __rcu **rht_bucket_nested_insert(struct rhashtable *ht,
@@ -459,6 +459,79 @@ size_t ZSTD_decompress_usingDDict(ZSTD_DCtx *dctx, void *dst,
 	const ZSTD_DDict *ddict);
 
 
+/*-**************************
+ * Parallel compression
+ ***************************/
+
+/**
+ * ZSTD_parallelWorkspaceBound() - memory needed to initialize a ZSTD_parallelCtx
+ * @cParams:   The compression parameters to be used for compression.
+ * @nbWorkers: The number of chunks to compress concurrently.
+ *
+ * Return:     A lower bound on the size of the workspace that is passed to
+ *             ZSTD_initParallelCtx().
+ */
+size_t ZSTD_parallelWorkspaceBound(ZSTD_compressionParameters cParams,
+	unsigned int nbWorkers);
+
+/**
+ * struct ZSTD_parallelCtx - a set of compression contexts for parallel use
+ *
+ * Compresses a large buffer as a sequence of independent frames, one per
+ * chunkSize bytes of input, using up to nbWorkers CPUs at once. The frames
+ * are concatenated in order, so the output is decompressed like any other
+ * multi-frame zstd data. Matches cannot cross chunk boundaries, so smaller
+ * chunks compress worse. A few MB per chunk costs very little ratio.
+ */
+typedef struct ZSTD_parallelCtx_s ZSTD_parallelCtx;
+/**
+ * ZSTD_initParallelCtx() - initialize a parallel compression context
+ * @params:        The parameters to use for every chunk. See ZSTD_getParams(),
+ *                 preferably with chunkSize as the estimated source size.
+ * @chunkSize:     The amount of input compressed into each frame.
+ * @nbWorkers:     The number of chunks that may be compressed concurrently,
+ *                 typically num_online_cpus().
+ * @workspace:     The workspace to emplace the context into. It must outlive
+ *                 the returned context.
+ * @workspaceSize: The size of workspace. Use ZSTD_parallelWorkspaceBound() to
+ *                 determine how large the workspace must be.
+ *
+ * Return:         A parallel compression context emplaced into workspace, or
+ *                 NULL if the workspace is too small.
+ */
+ZSTD_parallelCtx *ZSTD_initParallelCtx(ZSTD_parameters params, size_t chunkSize,
+	unsigned int nbWorkers, void *workspace, size_t workspaceSize);
+
+/**
+ * ZSTD_parallelCompressBound() - dst capacity needed by ZSTD_compressParallel()
+ * @srcSize:   The size of the data to compress.
+ * @chunkSize: The chunk size the context was initialized with.
+ *
+ * Return:     The destination buffer size ZSTD_compressParallel() requires.
+ *             This is slightly more than ZSTD_compressBound(srcSize), because
+ *             every chunk is first compressed into its own slot of dst.
+ */
+size_t ZSTD_parallelCompressBound(size_t srcSize, size_t chunkSize);
+
+/**
+ * ZSTD_compressParallel() - compress src into dst using several CPUs
+ * @pctx:        The parallel compression context.
+ * @dst:         The buffer to compress src into. It must be at least
+ *               ZSTD_parallelCompressBound(srcSize, chunkSize) bytes.
+ * @dstCapacity: The size of the destination buffer.
+ * @src:         The data to compress.
+ * @srcSize:     The size of the data to compress.
+ *
+ * The calling thread compresses chunks itself and hands the others to
+ * workers on the unbound workqueue, so it must be allowed to sleep. A
+ * context may only be used by one caller at a time.
+ *
+ * Return:       The compressed size or an error, which can be checked using
+ *               ZSTD_isError().
+ */
+size_t ZSTD_compressParallel(ZSTD_parallelCtx *pctx, void *dst,
+	size_t dstCapacity, const void *src, size_t srcSize);
+
 /*-**************************
  * Streaming
  ***************************/
@@ -7,6 +7,7 @@
 #include <linux/cpumask.h>
 #include <linux/spinlock.h>
 #include <linux/percpu.h>
+#include <linux/slab.h>
 
 #include "bpf_lru_list.h"
 
@@ -16,6 +17,11 @@
 #define PERCPU_FREE_TARGET		(4)
 #define PERCPU_NR_SCANS			PERCPU_FREE_TARGET
 
+/* Sharding of the common LRU list */
+#define LRU_CPUS_PER_SHARD		(4)
+#define LRU_MAX_SHARDS			(16)
+#define LRU_MIN_SHARD_ELEMS		(2 * LOCAL_FREE_TARGET)
+
 /* Helpers to get the local list index */
 #define LOCAL_LIST_IDX(t)	((t) - BPF_LOCAL_LIST_T_OFFSET)
 #define LOCAL_FREE_LIST_IDX	LOCAL_LIST_IDX(BPF_LRU_LOCAL_LIST_T_FREE)
@@ -30,6 +36,18 @@ static int get_next_cpu(int cpu)
 	return cpu;
 }
 
+/* A node sitting in one of the common LRU shards always has
+ * node->cpu pointing to a CPU that maps to that shard:
+ * bpf_common_lru_populate() initializes it that way and
+ * a node only enters a shard by being flushed from the
+ * pending list of node->cpu.
+ */
+static struct bpf_lru_list *common_lru_shard(struct bpf_common_lru *clru,
+					     int cpu)
+{
+	return &clru->shards[cpu % clru->nr_shards];
+}
+
 /* Local list helpers */
 static struct list_head *local_free_list(struct bpf_lru_locallist *loc_l)
 {
@@ -318,17 +336,17 @@ static void bpf_lru_list_push_free(struct bpf_lru_list *l,
 	raw_spin_unlock_irqrestore(&l->lock, flags);
 }
 
-static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
-					   struct bpf_lru_locallist *loc_l)
+/* Move up to LOCAL_FREE_TARGET free nodes from l to the local
+ * free list, shrinking l if it does not have enough of them.
+ * Caller must hold l->lock.
+ */
+static unsigned int
+__bpf_lru_list_pop_free_to_local(struct bpf_lru *lru, struct bpf_lru_list *l,
+				 struct bpf_lru_locallist *loc_l)
 {
-	struct bpf_lru_list *l = &lru->common_lru.lru_list;
 	struct bpf_lru_node *node, *tmp_node;
 	unsigned int nfree = 0;
 
-	raw_spin_lock(&l->lock);
-
-	__local_list_flush(l, loc_l);
-
 	__bpf_lru_list_rotate(lru, l);
 
 	list_for_each_entry_safe(node, tmp_node, &l->lists[BPF_LRU_LIST_T_FREE],
@@ -340,11 +358,41 @@ static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
 	}
 
 	if (nfree < LOCAL_FREE_TARGET)
-		__bpf_lru_list_shrink(lru, l, LOCAL_FREE_TARGET - nfree,
-				      local_free_list(loc_l),
-				      BPF_LRU_LOCAL_LIST_T_FREE);
+		nfree += __bpf_lru_list_shrink(lru, l,
+					       LOCAL_FREE_TARGET - nfree,
+					       local_free_list(loc_l),
+					       BPF_LRU_LOCAL_LIST_T_FREE);
+
+	return nfree;
+}
+
+static void bpf_lru_list_pop_free_to_local(struct bpf_lru *lru,
+					   struct bpf_lru_locallist *loc_l,
+					   int cpu)
+{
+	struct bpf_common_lru *clru = &lru->common_lru;
+	unsigned int i, home, nfree;
+	struct bpf_lru_list *l;
 
+	home = cpu % clru->nr_shards;
+	l = &clru->shards[home];
+
+	raw_spin_lock(&l->lock);
+	__local_list_flush(l, loc_l);
+	nfree = __bpf_lru_list_pop_free_to_local(lru, l, loc_l);
 	raw_spin_unlock(&l->lock);
+
+	/* Every node of the home shard is sitting in some local
+	 * list.  Refill from the other shards before resorting to
+	 * stealing from the other CPUs.
+	 */
+	for (i = 1; !nfree && i < clru->nr_shards; i++) {
+		l = &clru->shards[(home + i) % clru->nr_shards];
+
+		raw_spin_lock(&l->lock);
+		nfree = __bpf_lru_list_pop_free_to_local(lru, l, loc_l);
+		raw_spin_unlock(&l->lock);
+	}
 }
 
 static void __local_list_add_pending(struct bpf_lru *lru,
@@ -447,7 +495,7 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 
 	node = __local_list_pop_free(loc_l);
 	if (!node) {
-		bpf_lru_list_pop_free_to_local(lru, loc_l);
+		bpf_lru_list_pop_free_to_local(lru, loc_l, cpu);
 		node = __local_list_pop_free(loc_l);
 	}
 
@@ -460,7 +508,7 @@ static struct bpf_lru_node *bpf_common_lru_pop_free(struct bpf_lru *lru,
 		return node;
 
 	/* No free nodes found from the local free list and
-	 * the global LRU list.
+	 * the LRU shards.
 	 *
 	 * Steal from the local free/pending list of the
 	 * current CPU and remote CPU in RR.  It starts
@@ -532,7 +580,8 @@ static void bpf_common_lru_push_free(struct bpf_lru *lru,
 	}
 
 check_lru_list:
-	bpf_lru_list_push_free(&lru->common_lru.lru_list, node);
+	bpf_lru_list_push_free(common_lru_shard(&lru->common_lru, node->cpu),
+			       node);
 }
 
 static void bpf_percpu_lru_push_free(struct bpf_lru *lru,
@@ -562,17 +611,29 @@ static void bpf_common_lru_populate(struct bpf_lru *lru, void *buf,
 				    u32 node_offset, u32 elem_size,
 				    u32 nr_elems)
 {
-	struct bpf_lru_list *l = &lru->common_lru.lru_list;
+	struct bpf_common_lru *clru = &lru->common_lru;
+	int cpu = cpumask_first(cpu_possible_mask);
+	struct bpf_lru_list *l;
 	u32 i;
 
+	/* Small maps do not benefit from sharding and would only
+	 * lose LRU accuracy.  Keep enough nodes in each shard for
+	 * a couple of local free list refills.
+	 */
+	clru->nr_shards = clamp_t(u32, nr_elems / LRU_MIN_SHARD_ELEMS, 1,
+				  clru->nr_shards);
+
 	for (i = 0; i < nr_elems; i++) {
 		struct bpf_lru_node *node;
 
+		l = common_lru_shard(clru, cpu);
 		node = (struct bpf_lru_node *)(buf + node_offset);
+		node->cpu = cpu;
 		node->type = BPF_LRU_LIST_T_FREE;
 		node->ref = 0;
 		list_add(&node->list, &l->lists[BPF_LRU_LIST_T_FREE]);
 		buf += elem_size;
+		cpu = get_next_cpu(cpu);
 	}
 }
 
@@ -664,10 +725,21 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 		lru->nr_scans = PERCPU_NR_SCANS;
 	} else {
 		struct bpf_common_lru *clru = &lru->common_lru;
+		unsigned int i;
+
+		clru->nr_shards = min_t(unsigned int, LRU_MAX_SHARDS,
+					DIV_ROUND_UP(num_possible_cpus(),
+						     LRU_CPUS_PER_SHARD));
+		clru->shards = kcalloc(clru->nr_shards, sizeof(*clru->shards),
+				       GFP_USER | __GFP_NOWARN);
+		if (!clru->shards)
+			return -ENOMEM;
 
 		clru->local_list = alloc_percpu(struct bpf_lru_locallist);
-		if (!clru->local_list)
+		if (!clru->local_list) {
+			kfree(clru->shards);
 			return -ENOMEM;
+		}
 
 		for_each_possible_cpu(cpu) {
 			struct bpf_lru_locallist *loc_l;
@@ -676,7 +748,8 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 			bpf_lru_locallist_init(loc_l, cpu);
 		}
 
-		bpf_lru_list_init(&clru->lru_list);
+		for (i = 0; i < clru->nr_shards; i++)
+			bpf_lru_list_init(&clru->shards[i]);
 		lru->nr_scans = LOCAL_NR_SCANS;
 	}
 
@@ -690,8 +763,10 @@ int bpf_lru_init(struct bpf_lru *lru, bool percpu, u32 hash_offset,
 
 void bpf_lru_destroy(struct bpf_lru *lru)
 {
-	if (lru->percpu)
+	if (lru->percpu) {
 		free_percpu(lru->percpu_lru);
-	else
+	} else {
 		free_percpu(lru->common_lru.local_list);
+		kfree(lru->common_lru.shards);
+	}
 }
@@ -46,7 +46,12 @@ struct bpf_lru_locallist {
 };
 
 struct bpf_common_lru {
-	struct bpf_lru_list lru_list;
+	/* Each CPU refills its local free list from shard
+	 * (cpu % nr_shards) so that the refills from different
+	 * CPUs do not all serialize on one lock.
+	 */
+	struct bpf_lru_list *shards;
+	unsigned int nr_shards;
 	struct bpf_lru_locallist __percpu *local_list;
 };
 
@@ -2695,6 +2695,10 @@ static void ctx_sched_out(struct perf_event_context *ctx,
 
 	is_active ^= ctx->is_active; /* changed bits */
 
+	/* ctx_flexible_sched_in() will tell again whether to rotate */
+	if (is_active & EVENT_FLEXIBLE)
+		ctx->rotate_necessary = 0;
+
 	if (!ctx->nr_active || !(is_active & EVENT_ALL))
 		return;
 
@@ -3035,8 +3039,12 @@ ctx_flexible_sched_in(struct perf_event_context *ctx,
 			continue;
 
 		if (group_can_go_on(event, cpuctx, can_add_hw)) {
-			if (group_sched_in(event, cpuctx, ctx))
+			if (group_sched_in(event, cpuctx, ctx)) {
 				can_add_hw = 0;
+				ctx->rotate_necessary = 1;
+			}
+		} else {
+			ctx->rotate_necessary = 1;
 		}
 	}
 }
@@ -3362,41 +3370,43 @@ static void rotate_ctx(struct perf_event_context *ctx)
 
 static int perf_rotate_context(struct perf_cpu_context *cpuctx)
 {
-	struct perf_event_context *ctx = NULL;
-	int rotate = 0;
-
-	if (cpuctx->ctx.nr_events) {
-		if (cpuctx->ctx.nr_events != cpuctx->ctx.nr_active)
-			rotate = 1;
-	}
+	struct perf_event_context *ctx = cpuctx->task_ctx;
+	int cpu_rotate, task_rotate;
 
-	ctx = cpuctx->task_ctx;
-	if (ctx && ctx->nr_events) {
-		if (ctx->nr_events != ctx->nr_active)
-			rotate = 1;
-	}
+	/*
+	 * Only rotate a context whose flexible groups did not all fit on
+	 * the PMU. Events that are merely disabled, or filtered out for
+	 * this CPU or cgroup, do not need any counter time, and rotating
+	 * around them would only take the counters away from the events
+	 * that do run.
+	 */
+	cpu_rotate = cpuctx->ctx.rotate_necessary;
+	task_rotate = ctx ? ctx->rotate_necessary : 0;
 
-	if (!rotate)
-		goto done;
+	if (!(cpu_rotate || task_rotate))
+		return 0;
 
 	perf_ctx_lock(cpuctx, cpuctx->task_ctx);
 	perf_pmu_disable(cpuctx->ctx.pmu);
 
-	cpu_ctx_sched_out(cpuctx, EVENT_FLEXIBLE);
-	if (ctx)
+	if (task_rotate)
 		ctx_sched_out(ctx, cpuctx, EVENT_FLEXIBLE);
+	if (cpu_rotate)
+		cpu_ctx_sched_out(cpuctx, EVENT_FLEXIBLE);
 
-	rotate_ctx(&cpuctx->ctx);
-	if (ctx)
+	if (cpu_rotate)
+		rotate_ctx(&cpuctx->ctx);
+	if (task_rotate)
 		rotate_ctx(ctx);
 
 	perf_event_sched_in(cpuctx, ctx, current);
 
 	perf_pmu_enable(cpuctx->ctx.pmu);
 	perf_ctx_unlock(cpuctx, cpuctx->task_ctx);
-done:
 
-	return rotate;
+	cpuctx->nr_rotations++;
+
+	return 1;
 }
 
 void perf_event_task_tick(void)
@@ -5285,7 +5295,7 @@ static int perf_mmap(struct file *file, struct vm_area_struct *vma)
 again:
 	mutex_lock(&event->mmap_mutex);
 	if (event->rb) {
-		if (event->rb->nr_pages != nr_pages) {
+		if (data_page_nr(event->rb) != nr_pages) {
 			ret = -EINVAL;
 			goto unlock;
 		}
@@ -8986,9 +8996,30 @@ perf_event_mux_interval_ms_store(struct device *dev,
 }
 static DEVICE_ATTR_RW(perf_event_mux_interval_ms);
 
+static ssize_t
+perf_event_mux_rotations_show(struct device *dev,
+			      struct device_attribute *attr,
+			      char *page)
+{
+	struct pmu *pmu = dev_get_drvdata(dev);
+	u64 rotations = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct perf_cpu_context *cpuctx;
+
+		cpuctx = per_cpu_ptr(pmu->pmu_cpu_context, cpu);
+		rotations += READ_ONCE(cpuctx->nr_rotations);
+	}
+
+	return snprintf(page, PAGE_SIZE-1, "%llu\n", rotations);
+}
+static DEVICE_ATTR_RO(perf_event_mux_rotations);
+
 static struct attribute *pmu_dev_attrs[] = {
 	&dev_attr_type.attr,
 	&dev_attr_perf_event_mux_interval_ms.attr,
+	&dev_attr_perf_event_mux_rotations.attr,
 	NULL,
 };
 ATTRIBUTE_GROUPS(pmu_dev);
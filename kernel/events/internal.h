@@ -14,9 +14,9 @@ struct ring_buffer {
 	struct rcu_head			rcu_head;
 #ifdef CONFIG_PERF_USE_VMALLOC
 	struct work_struct		work;
-	int				page_order;	/* allocation order  */
 #endif
-	int				nr_pages;	/* nr of data pages  */
+	int				page_order;	/* allocation order  */
+	int				nr_pages;	/* nr of data chunks */
 	int				overwrite;	/* can overwrite itself */
 	int				paused;		/* can write into ring buffer */
 
@@ -94,25 +94,19 @@ void perf_event_aux_event(struct perf_event *event, unsigned long head,
 extern struct page *
 perf_mmap_to_page(struct ring_buffer *rb, unsigned long pgoff);
 
-#ifdef CONFIG_PERF_USE_VMALLOC
 /*
- * Back perf_mmap() with vmalloc memory.
- *
- * Required for architectures that have d-cache aliasing issues.
+ * The data buffer is made of nr_pages chunks of (PAGE_SIZE << page_order)
+ * bytes each.
  */
-
 static inline int page_order(struct ring_buffer *rb)
 {
 	return rb->page_order;
 }
 
-#else
-
-static inline int page_order(struct ring_buffer *rb)
+static inline int data_page_nr(struct ring_buffer *rb)
 {
-	return 0;
+	return rb->nr_pages << page_order(rb);
 }
-#endif
 
 static inline unsigned long perf_data_size(struct ring_buffer *rb)
 {
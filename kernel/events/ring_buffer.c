@@ -685,39 +685,76 @@ void rb_free_aux(struct ring_buffer *rb)
 #ifndef CONFIG_PERF_USE_VMALLOC
 
 /*
- * Back perf_mmap() with regular GFP_KERNEL-0 pages.
+ * Back perf_mmap() with regular GFP_KERNEL pages.
+ *
+ * The data buffer is allocated in physically contiguous chunks of up to
+ * PERF_DATA_MAX_ORDER, which means fewer chunk switches in the output
+ * path and fewer TLB misses when the buffer is large.  Chunks are split
+ * into order-0 pages so that each page can be mapped and refcounted on
+ * its own by perf_mmap_fault().  If memory is too fragmented for large
+ * chunks, we fall back to smaller ones, down to single pages.
  */
+#define PERF_DATA_MAX_ORDER	min(9, MAX_ORDER - 1)
+#define PERF_DATA_GFP		(GFP_KERNEL | __GFP_ZERO | __GFP_NOWARN | \
+				 __GFP_NORETRY)
 
 static struct page *
 __perf_mmap_to_page(struct ring_buffer *rb, unsigned long pgoff)
 {
-	if (pgoff > rb->nr_pages)
+	unsigned long mask = (1UL << page_order(rb)) - 1;
+	struct page *page;
+
+	if (pgoff > data_page_nr(rb))
 		return NULL;
 
 	if (pgoff == 0)
 		return virt_to_page(rb->user_page);
 
-	return virt_to_page(rb->data_pages[pgoff - 1]);
+	pgoff--;
+	page = virt_to_page(rb->data_pages[pgoff >> page_order(rb)]);
+
+	return page + (pgoff & mask);
 }
 
-static void *perf_mmap_alloc_page(int cpu)
+static void *perf_mmap_alloc_page(int cpu, int order)
 {
 	struct page *page;
 	int node;
+	gfp_t gfp;
 
+	gfp = order ? PERF_DATA_GFP : GFP_KERNEL | __GFP_ZERO;
 	node = (cpu == -1) ? cpu : cpu_to_node(cpu);
-	page = alloc_pages_node(node, GFP_KERNEL | __GFP_ZERO, 0);
+	page = alloc_pages_node(node, gfp, order);
 	if (!page)
 		return NULL;
 
+	if (order)
+		split_page(page, order);
+
 	return page_address(page);
 }
 
+static void perf_mmap_free_page(unsigned long addr)
+{
+	struct page *page = virt_to_page((void *)addr);
+
+	page->mapping = NULL;
+	__free_page(page);
+}
+
+static void perf_mmap_free_chunk(void *addr, int order)
+{
+	int i;
+
+	for (i = 0; i < (1 << order); i++)
+		perf_mmap_free_page((unsigned long)addr + i * PAGE_SIZE);
+}
+
 struct ring_buffer *rb_alloc(int nr_pages, long watermark, int cpu, int flags)
 {
 	struct ring_buffer *rb;
 	unsigned long size;
-	int i;
+	int i, order, nr_chunks;
 
 	size = sizeof(struct ring_buffer);
 	size += nr_pages * sizeof(void *);
@@ -726,26 +763,37 @@ struct ring_buffer *rb_alloc(int nr_pages, long watermark, int cpu, int flags)
 	if (!rb)
 		goto fail;
 
-	rb->user_page = perf_mmap_alloc_page(cpu);
+	rb->user_page = perf_mmap_alloc_page(cpu, 0);
 	if (!rb->user_page)
 		goto fail_user_page;
 
-	for (i = 0; i < nr_pages; i++) {
-		rb->data_pages[i] = perf_mmap_alloc_page(cpu);
-		if (!rb->data_pages[i])
+	order = nr_pages ? min(ilog2(nr_pages), PERF_DATA_MAX_ORDER) : 0;
+	for (;;) {
+		nr_chunks = nr_pages >> order;
+		for (i = 0; i < nr_chunks; i++) {
+			rb->data_pages[i] = perf_mmap_alloc_page(cpu, order);
+			if (!rb->data_pages[i])
+				break;
+		}
+		if (i == nr_chunks)
+			break;
+
+		for (i--; i >= 0; i--)
+			perf_mmap_free_chunk(rb->data_pages[i], order);
+
+		if (!order)
 			goto fail_data_pages;
+		order--;
 	}
 
-	rb->nr_pages = nr_pages;
+	rb->nr_pages = nr_chunks;
+	rb->page_order = order;
 
 	ring_buffer_init(rb, watermark, flags);
 
 	return rb;
 
 fail_data_pages:
-	for (i--; i >= 0; i--)
-		free_page((unsigned long)rb->data_pages[i]);
-
 	free_page((unsigned long)rb->user_page);
 
 fail_user_page:
@@ -755,30 +803,17 @@ struct ring_buffer *rb_alloc(int nr_pages, long watermark, int cpu, int flags)
 	return NULL;
 }
 
-static void perf_mmap_free_page(unsigned long addr)
-{
-	struct page *page = virt_to_page((void *)addr);
-
-	page->mapping = NULL;
-	__free_page(page);
-}
-
 void rb_free(struct ring_buffer *rb)
 {
 	int i;
 
 	perf_mmap_free_page((unsigned long)rb->user_page);
 	for (i = 0; i < rb->nr_pages; i++)
-		perf_mmap_free_page((unsigned long)rb->data_pages[i]);
+		perf_mmap_free_chunk(rb->data_pages[i], page_order(rb));
 	kfree(rb);
 }
 
 #else
-static int data_page_nr(struct ring_buffer *rb)
-{
-	return rb->nr_pages << page_order(rb);
-}
-
 static struct page *
 __perf_mmap_to_page(struct ring_buffer *rb, unsigned long pgoff)
 {
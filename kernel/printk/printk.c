@@ -42,6 +42,7 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
 #include <linux/utsname.h>
 #include <linux/ctype.h>
 #include <linux/uio.h>
@@ -1680,6 +1681,37 @@ static size_t log_output(int facility, int level, enum log_flags lflags, const c
 	return log_store(facility, level, lflags, 0, dict, dictlen, text, text_len);
 }
 
+/*
+ * Console output is normally handed off to printk_kthread, so that the
+ * caller of printk() only pays for storing the record and never for
+ * pushing it through slow console drivers.  We print directly from the
+ * caller while the kthread is not running yet, outside of normal system
+ * operation (boot and shutdown), and whenever an oops or panic is in
+ * progress, since the kthread might never get to run again.
+ */
+static struct task_struct *printk_kthread __read_mostly;
+
+static bool __read_mostly printk_synchronous;
+module_param_named(synchronous, printk_synchronous, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(synchronous,
+		 "print to consoles from the context of the printk() caller");
+
+static void defer_console_output(void);
+
+static bool console_offload_printing(void)
+{
+	if (printk_synchronous || !READ_ONCE(printk_kthread))
+		return false;
+
+	if (system_state != SYSTEM_RUNNING)
+		return false;
+
+	if (oops_in_progress || atomic_read(&panic_cpu) != PANIC_CPU_INVALID)
+		return false;
+
+	return true;
+}
+
 asmlinkage int vprintk_emit(int facility, int level,
 			    const char *dict, size_t dictlen,
 			    const char *fmt, va_list args)
@@ -1751,9 +1783,12 @@ asmlinkage int vprintk_emit(int facility, int level,
 		/*
 		 * Try to acquire and then immediately release the console
 		 * semaphore.  The release will print out buffers and wake up
-		 * /dev/kmsg and syslog() users.
+		 * /dev/kmsg and syslog() users.  Leave that to printk_kthread
+		 * if we can.
 		 */
-		if (console_trylock())
+		if (console_offload_printing())
+			defer_console_output();
+		else if (console_trylock())
 			console_unlock();
 	}
 
@@ -2690,8 +2725,10 @@ static void wake_up_klogd_work_func(struct irq_work *irq_work)
 	int pending = __this_cpu_xchg(printk_pending, 0);
 
 	if (pending & PRINTK_PENDING_OUTPUT) {
+		if (console_offload_printing())
+			wake_up_process(printk_kthread);
 		/* If trylock fails, someone else is doing the printing */
-		if (console_trylock())
+		else if (console_trylock())
 			console_unlock();
 	}
 
@@ -2714,16 +2751,20 @@ void wake_up_klogd(void)
 	preempt_enable();
 }
 
-int vprintk_deferred(const char *fmt, va_list args)
+static void defer_console_output(void)
 {
-	int r;
-
-	r = vprintk_emit(0, LOGLEVEL_SCHED, NULL, 0, fmt, args);
-
 	preempt_disable();
 	__this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
 	irq_work_queue(this_cpu_ptr(&wake_up_klogd_work));
 	preempt_enable();
+}
+
+int vprintk_deferred(const char *fmt, va_list args)
+{
+	int r;
+
+	r = vprintk_emit(0, LOGLEVEL_SCHED, NULL, 0, fmt, args);
+	defer_console_output();
 
 	return r;
 }
@@ -2740,6 +2781,54 @@ int printk_deferred(const char *fmt, ...)
 	return r;
 }
 
+static bool printk_kthread_pending(void)
+{
+	unsigned long flags;
+	bool pending;
+
+	logbuf_lock_irqsave(flags);
+	pending = console_seq != log_next_seq;
+	logbuf_unlock_irqrestore(flags);
+
+	/* resume_console() flushes whatever piled up while suspended */
+	return pending && !READ_ONCE(console_suspended);
+}
+
+static int printk_kthread_func(void *data)
+{
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!printk_kthread_pending())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		/*
+		 * console_lock() allows console_unlock() to reschedule
+		 * between records, so a long backlog on a slow console
+		 * does not monopolize this CPU either.
+		 */
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *tsk;
+
+	tsk = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(tsk)) {
+		pr_err("printk: unable to start printing thread, printing synchronously\n");
+		return PTR_ERR(tsk);
+	}
+	WRITE_ONCE(printk_kthread, tsk);
+
+	return 0;
+}
+late_initcall(printk_kthread_init);
+
 /*
  * printk rate limiting, lifted from the networking subsystem.
  *
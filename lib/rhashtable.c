@@ -28,9 +28,13 @@
 #include <linux/rhashtable.h>
 #include <linux/err.h>
 #include <linux/export.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 
 #define HASH_DEFAULT_SIZE	64UL
 #define HASH_MIN_SIZE		4U
+#define HASH_DEFAULT_GROW	75
+#define HASH_DEFAULT_SHRINK	30
 #define BUCKET_LOCKS_PER_CPU	32UL
 
 union nested_table {
@@ -354,21 +358,32 @@ static int rhashtable_rehash_table(struct rhashtable *ht)
 	struct bucket_table *new_tbl;
 	struct rhashtable_walker *walker;
 	unsigned int old_hash;
+	u64 start;
 	int err;
 
 	new_tbl = rht_dereference(old_tbl->future_tbl, ht);
 	if (!new_tbl)
 		return 0;
 
+	start = ktime_get_ns();
+
 	for (old_hash = 0; old_hash < old_tbl->size; old_hash++) {
 		err = rhashtable_rehash_chain(ht, old_hash);
 		if (err)
 			return err;
+
+		/* Insertions already go to the new table, so it is fine to
+		 * let other work run between chains of a large table.
+		 */
+		cond_resched();
 	}
 
 	/* Publish the new table pointer. */
 	rcu_assign_pointer(ht->tbl, new_tbl);
 
+	ht->rehashes++;
+	ht->rehash_ns += ktime_get_ns() - start;
+
 	spin_lock(&ht->lock);
 	list_for_each_entry(walker, &old_tbl->walkers, list)
 		walker->tbl = NULL;
@@ -425,8 +440,12 @@ static int rhashtable_shrink(struct rhashtable *ht)
 	unsigned int nelems = atomic_read(&ht->nelems);
 	unsigned int size = 0;
 
+	/* Leave enough room that the new table is not above its own grow
+	 * threshold straight away.
+	 */
 	if (nelems)
-		size = roundup_pow_of_two(nelems * 3 / 2);
+		size = roundup_pow_of_two(max_t(u64, nelems * 3 / 2,
+			div_u64((u64)nelems * 100, ht->p.grow_threshold) + 1));
 	if (size < ht->p.min_size)
 		size = ht->p.min_size;
 
@@ -927,6 +946,12 @@ static u32 rhashtable_jhash2(const void *key, u32 length, u32 seed)
  *	.hashfn = jhash,
  *	.obj_hashfn = my_hash_fn,
  * };
+ *
+ * The table grows once it is more than @grow_threshold percent full and,
+ * with @automatic_shrinking, shrinks once it is less than @shrink_threshold
+ * percent full.  Zero selects the defaults of 75 and 30.  Insert-heavy
+ * users can lower @grow_threshold to start resizing earlier and keep chains
+ * short; @shrink_threshold must stay below half of @grow_threshold.
  */
 int rhashtable_init(struct rhashtable *ht,
 		    const struct rhashtable_params *params)
@@ -962,6 +987,18 @@ int rhashtable_init(struct rhashtable *ht,
 
 	ht->p.min_size = max_t(u16, ht->p.min_size, HASH_MIN_SIZE);
 
+	if (!ht->p.grow_threshold)
+		ht->p.grow_threshold = HASH_DEFAULT_GROW;
+	if (!ht->p.shrink_threshold)
+		ht->p.shrink_threshold = HASH_DEFAULT_SHRINK;
+
+	/* A table must be able to grow before it overflows, and a freshly
+	 * shrunk table must not be eligible for shrinking again.
+	 */
+	if (ht->p.grow_threshold > 100 ||
+	    ht->p.shrink_threshold * 2 >= ht->p.grow_threshold)
+		return -EINVAL;
+
 	if (params->nelem_hint)
 		size = rounded_hashtable_size(&ht->p);
 
@@ -1088,6 +1125,52 @@ void rhashtable_destroy(struct rhashtable *ht)
 }
 EXPORT_SYMBOL_GPL(rhashtable_destroy);
 
+/**
+ * rhashtable_get_stats - collect hash table statistics
+ * @ht:		the hash table
+ * @stats:	filled in with the statistics
+ *
+ * Walks every bucket of the current table to measure chain lengths, so
+ * this is meant for debugging and benchmarks rather than fast paths.
+ * Entries that already moved to a future table during a resize are not
+ * counted in @stats->used_buckets or @stats->max_chain.
+ *
+ * This function may sleep waiting for a running resize to finish.
+ */
+void rhashtable_get_stats(struct rhashtable *ht,
+			  struct rhashtable_stats *stats)
+{
+	struct bucket_table *tbl;
+	struct rhash_head *pos;
+	unsigned int i, len;
+
+	memset(stats, 0, sizeof(*stats));
+
+	mutex_lock(&ht->mutex);
+	rcu_read_lock();
+
+	tbl = rht_dereference(ht->tbl, ht);
+	stats->size = tbl->size;
+
+	for (i = 0; i < tbl->size; i++) {
+		len = 0;
+		rht_for_each_rcu(pos, tbl, i)
+			len++;
+
+		if (len)
+			stats->used_buckets++;
+		stats->max_chain = max(stats->max_chain, len);
+	}
+
+	rcu_read_unlock();
+
+	stats->nelems = atomic_read(&ht->nelems);
+	stats->rehashes = ht->rehashes;
+	stats->rehash_ns = ht->rehash_ns;
+	mutex_unlock(&ht->mutex);
+}
+EXPORT_SYMBOL_GPL(rhashtable_get_stats);
+
 struct rhash_head __rcu **rht_bucket_nested(const struct bucket_table *tbl,
 					    unsigned int hash)
 {
@@ -6286,6 +6286,40 @@ static struct bpf_prog *generate_filter(int which, int *err)
 	return fp;
 }
 
+/* Build an interpreted copy of a JITed eBPF program, so that both can be
+ * timed on the same input.  JITs that ignore fp->jit_requested leave the
+ * copy JITed as well, in which case there is nothing to compare against.
+ */
+static struct bpf_prog *generate_interp_filter(const struct bpf_prog *fp)
+{
+	struct bpf_prog *ip;
+	int err;
+
+	if (!fp->jited || !bpf_jit_is_ebpf())
+		return NULL;
+
+	ip = bpf_prog_alloc(bpf_prog_size(fp->len), 0);
+	if (ip == NULL)
+		return NULL;
+
+	ip->len = fp->len;
+	ip->type = BPF_PROG_TYPE_SOCKET_FILTER;
+	ip->jit_requested = 0;
+	memcpy(ip->insnsi, fp->insnsi, bpf_prog_insn_size(fp));
+	/* Programs converted from classic BPF may use scratch memory
+	 * without having a stack depth recorded.
+	 */
+	ip->aux->stack_depth = MAX_BPF_STACK;
+
+	ip = bpf_prog_select_runtime(ip, &err);
+	if (err || ip->jited) {
+		bpf_prog_free(ip);
+		return NULL;
+	}
+
+	return ip;
+}
+
 static void release_filter(struct bpf_prog *fp, int which)
 {
 	__u8 test_type = tests[which].aux & TEST_TYPE_MASK;
@@ -6319,14 +6353,18 @@ static int __run_one(const struct bpf_prog *fp, const void *data,
 	return ret;
 }
 
-static int run_one(const struct bpf_prog *fp, struct bpf_test *test)
+static u64 jit_total_ns, interp_total_ns;
+static int cmp_cnt;
+
+static int run_one(const struct bpf_prog *fp, const struct bpf_prog *ip,
+		   struct bpf_test *test)
 {
 	int err_cnt = 0, i, runs = MAX_TESTRUNS;
 
 	for (i = 0; i < MAX_SUBTESTS; i++) {
+		u64 duration, ip_duration = 0;
+		u32 ret, ip_ret = 0;
 		void *data;
-		u64 duration;
-		u32 ret;
 
 		if (test->test[i].data_size == 0 &&
 		    test->test[i].result == 0)
@@ -6339,10 +6377,22 @@ static int run_one(const struct bpf_prog *fp, struct bpf_test *test)
 			break;
 		}
 		ret = __run_one(fp, data, runs, &duration);
+		if (ip)
+			ip_ret = __run_one(ip, data, runs, &ip_duration);
 		release_test_data(test, data);
 
-		if (ret == test->test[i].result) {
-			pr_cont("%lld ", duration);
+		if (ip && ip_ret != ret) {
+			pr_cont("interp ret %d != jit ret %d ", ip_ret, ret);
+			err_cnt++;
+		} else if (ret == test->test[i].result) {
+			if (ip) {
+				pr_cont("%lld/%lld ", duration, ip_duration);
+				jit_total_ns += duration;
+				interp_total_ns += ip_duration;
+				cmp_cnt++;
+			} else {
+				pr_cont("%lld ", duration);
+			}
 		} else {
 			pr_cont("ret %d != %d ", ret,
 				test->test[i].result);
@@ -6362,6 +6412,12 @@ module_param(test_id, int, 0);
 static int test_range[2] = { 0, ARRAY_SIZE(tests) - 1 };
 module_param_array(test_range, int, NULL, 0);
 
+/* Also run every JITed program through the interpreter and report
+ * "jit/interp" ns per run for each subtest.
+ */
+static bool compare_interp;
+module_param(compare_interp, bool, 0);
+
 static __init int find_test_index(const char *test_name)
 {
 	int i;
@@ -6450,7 +6506,7 @@ static __init int test_bpf(void)
 	int jit_cnt = 0, run_cnt = 0;
 
 	for (i = 0; i < ARRAY_SIZE(tests); i++) {
-		struct bpf_prog *fp;
+		struct bpf_prog *fp, *ip = NULL;
 		int err;
 
 		if (exclude_test(i))
@@ -6474,8 +6530,13 @@ static __init int test_bpf(void)
 		if (fp->jited)
 			jit_cnt++;
 
-		err = run_one(fp, &tests[i]);
+		if (compare_interp)
+			ip = generate_interp_filter(fp);
+
+		err = run_one(fp, ip, &tests[i]);
 		release_filter(fp, i);
+		if (ip)
+			bpf_prog_free(ip);
 
 		if (err) {
 			pr_cont("FAIL (%d times)\n", err);
@@ -6488,6 +6549,10 @@ static __init int test_bpf(void)
 
 	pr_info("Summary: %d PASSED, %d FAILED, [%d/%d JIT'ed]\n",
 		pass_cnt, err_cnt, jit_cnt, run_cnt);
+	if (cmp_cnt)
+		pr_info("JIT vs interpreter over %d subtests: %llu ns vs %llu ns per run\n",
+			cmp_cnt, div_u64(jit_total_ns, cmp_cnt),
+			div_u64(interp_total_ns, cmp_cnt));
 
 	return err_cnt ? -EINVAL : 0;
 }
@@ -0,0 +1,116 @@
+/*
+ * Self-test and benchmark for csum_partial()
+ *
+ * Checks the (possibly architecture optimised) csum_partial() against a
+ * straightforward 16-bit one's complement sum, over random lengths and
+ * alignments, then reports its throughput for a few packet sizes.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <asm/unaligned.h>
+#include <net/checksum.h>
+
+#define TEST_BUF_LEN	(64 * 1024 + 64)
+#define TEST_ITERATIONS	100000
+
+/* Keeps the compiler from discarding the benchmark loop */
+static volatile __wsum test_csum_sink;
+
+static u16 __init ref_csum(const u8 *buf, int len)
+{
+	u32 sum = 0;
+	int i;
+
+	for (i = 0; i + 1 < len; i += 2)
+		sum += get_unaligned((const u16 *)(buf + i));
+	if (len & 1)
+#ifdef __LITTLE_ENDIAN
+		sum += buf[len - 1];
+#else
+		sum += buf[len - 1] << 8;
+#endif
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+
+	return ~sum;
+}
+
+static int __init test_csum_correctness(const u8 *buf)
+{
+	unsigned int i, off, len;
+
+	for (i = 0; i < TEST_ITERATIONS; i++) {
+		off = prandom_u32_max(64);
+		len = (i & 3) ? prandom_u32_max(256) :
+				prandom_u32_max(TEST_BUF_LEN - 64);
+
+		if ((__force u16)csum_fold(csum_partial(buf + off, len, 0)) !=
+		    ref_csum(buf + off, len)) {
+			pr_err("mismatch at offset %u, length %u\n", off, len);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static void __init test_csum_speed(const u8 *buf)
+{
+	static const unsigned int sizes[] __initconst = { 64, 1500, 65536 };
+	unsigned int i, j, iters;
+	__wsum sum = 0;
+	u64 start, ns;
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		iters = (64 << 20) / sizes[i];
+
+		start = ktime_get_ns();
+		for (j = 0; j < iters; j++)
+			sum = csum_partial(buf + (j & 1), sizes[i], sum);
+		ns = ktime_get_ns() - start;
+
+		pr_info("%6u bytes: %llu ns/call, %llu MB/s\n", sizes[i],
+			div_u64(ns, iters),
+			div64_u64((u64)iters * sizes[i] * 1000, ns ?: 1));
+	}
+
+	test_csum_sink = sum;
+}
+
+static int __init test_checksum_init(void)
+{
+	u8 *buf;
+	int err;
+
+	buf = kmalloc(TEST_BUF_LEN, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	prandom_bytes(buf, TEST_BUF_LEN);
+
+	err = test_csum_correctness(buf);
+	if (!err) {
+		test_csum_speed(buf);
+		pr_info("test passed\n");
+	}
+
+	kfree(buf);
+	return err;
+}
+
+static void __exit test_checksum_exit(void)
+{
+}
+
+module_init(test_checksum_init);
+module_exit(test_checksum_exit);
+MODULE_LICENSE("GPL");
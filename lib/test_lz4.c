@@ -0,0 +1,205 @@
+/*
+ * Test and benchmark for LZ4 decompression of page-sized blocks
+ *
+ * Compresses a buffer of generated, partly compressible pages one page
+ * at a time, the way zram stores them, then checks that every page
+ * decompresses back and reports the decompression throughput. Also
+ * round-trips a stream of dependent pages through the dictionary
+ * decoders.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/lz4.h>
+#include <linux/sizes.h>
+
+static unsigned int nr_pages = 4096;
+module_param(nr_pages, uint, 0444);
+MODULE_PARM_DESC(nr_pages, "Number of pages to compress (default: 4096)");
+
+static unsigned int rounds = 10;
+module_param(rounds, uint, 0444);
+MODULE_PARM_DESC(rounds, "Number of times every page is decompressed (default: 10)");
+
+#define SLOT_SIZE	LZ4_COMPRESSBOUND(PAGE_SIZE)
+
+/* Enough pages for the later ones to see a full 64KB prefix */
+#define STREAM_PAGES	(2 * SZ_64K / PAGE_SIZE)
+
+/* Text-like data: runs of a small alphabet with some random noise */
+static void __init fill_buffer(u8 *buf, size_t len)
+{
+	static const char words[] = "the quick brown fox jumps over a lazy dog ";
+	size_t i;
+
+	prandom_bytes(buf, len);
+	for (i = 0; i < len; i++)
+		if (buf[i] & 0xe0)
+			buf[i] = words[(i * 7 + (buf[i] & 3)) % (sizeof(words) - 1)];
+}
+
+/*
+ * Compress the first pages of @src as one stream, so that later pages
+ * reference earlier ones, and decode every page through
+ * LZ4_decompress_fast_usingDict(): once behind the pages decoded before
+ * it (prefix mode) and once into a separate buffer (external dictionary).
+ */
+static int __init test_lz4_stream(const u8 *src, unsigned int pages)
+{
+	u8 *cbuf, *out, *page;
+	LZ4_stream_t *stream;
+	unsigned int i;
+	int *clen;
+	int err = -ENOMEM;
+
+	cbuf = vmalloc(pages * SLOT_SIZE);
+	out = vmalloc(pages * PAGE_SIZE);
+	page = vmalloc(PAGE_SIZE);
+	stream = vmalloc(sizeof(*stream));
+	clen = vmalloc(pages * sizeof(*clen));
+	if (!cbuf || !out || !page || !stream || !clen)
+		goto out;
+
+	LZ4_resetStream(stream);
+	for (i = 0; i < pages; i++) {
+		clen[i] = LZ4_compress_fast_continue(stream,
+						     src + i * PAGE_SIZE,
+						     cbuf + i * SLOT_SIZE,
+						     PAGE_SIZE, SLOT_SIZE, 1);
+		if (!clen[i]) {
+			pr_err("stream compression of page %u failed\n", i);
+			err = -EINVAL;
+			goto out;
+		}
+	}
+
+	err = -EINVAL;
+	for (i = 0; i < pages; i++) {
+		if (LZ4_decompress_fast_usingDict(cbuf + i * SLOT_SIZE,
+						  out + i * PAGE_SIZE,
+						  PAGE_SIZE, out,
+						  i * PAGE_SIZE) != clen[i] ||
+		    memcmp(out + i * PAGE_SIZE, src + i * PAGE_SIZE,
+			   PAGE_SIZE)) {
+			pr_err("stream page %u does not round-trip with a prefix\n",
+			       i);
+			goto out;
+		}
+
+		if (LZ4_decompress_fast_usingDict(cbuf + i * SLOT_SIZE, page,
+						  PAGE_SIZE, out,
+						  i * PAGE_SIZE) != clen[i] ||
+		    memcmp(page, src + i * PAGE_SIZE, PAGE_SIZE)) {
+			pr_err("stream page %u does not round-trip with a dictionary\n",
+			       i);
+			goto out;
+		}
+	}
+	err = 0;
+out:
+	vfree(clen);
+	vfree(stream);
+	vfree(page);
+	vfree(out);
+	vfree(cbuf);
+	return err;
+}
+
+static int __init test_lz4_init(void)
+{
+	u8 *src, *dst = NULL, *out = NULL, *wrkmem = NULL;
+	size_t total = 0;
+	unsigned int i, r;
+	int *clen = NULL;
+	int err = -ENOMEM;
+	u64 start, ns;
+
+	if (!nr_pages || !rounds)
+		return -EINVAL;
+
+	src = vmalloc(nr_pages * PAGE_SIZE);
+	if (!src)
+		return -ENOMEM;
+	dst = vmalloc(nr_pages * SLOT_SIZE);
+	out = vmalloc(PAGE_SIZE);
+	wrkmem = vmalloc(LZ4_MEM_COMPRESS);
+	clen = vmalloc(nr_pages * sizeof(*clen));
+	if (!dst || !out || !wrkmem || !clen)
+		goto out;
+
+	fill_buffer(src, nr_pages * PAGE_SIZE);
+
+	for (i = 0; i < nr_pages; i++) {
+		clen[i] = LZ4_compress_default(src + i * PAGE_SIZE,
+					       dst + i * SLOT_SIZE, PAGE_SIZE,
+					       SLOT_SIZE, wrkmem);
+		if (!clen[i]) {
+			pr_err("compression of page %u failed\n", i);
+			err = -EINVAL;
+			goto out;
+		}
+		total += clen[i];
+	}
+
+	for (i = 0; i < nr_pages; i++) {
+		if (LZ4_decompress_safe(dst + i * SLOT_SIZE, out, clen[i],
+					PAGE_SIZE) != PAGE_SIZE ||
+		    memcmp(out, src + i * PAGE_SIZE, PAGE_SIZE)) {
+			pr_err("page %u does not round-trip\n", i);
+			err = -EINVAL;
+			goto out;
+		}
+
+		memset(out, 0, PAGE_SIZE);
+		if (LZ4_decompress_fast(dst + i * SLOT_SIZE, out,
+					PAGE_SIZE) != clen[i] ||
+		    memcmp(out, src + i * PAGE_SIZE, PAGE_SIZE)) {
+			pr_err("page %u does not round-trip in fast mode\n", i);
+			err = -EINVAL;
+			goto out;
+		}
+	}
+
+	err = test_lz4_stream(src, min_t(unsigned int, nr_pages,
+					 STREAM_PAGES));
+	if (err)
+		goto out;
+
+	start = ktime_get_ns();
+	for (r = 0; r < rounds; r++)
+		for (i = 0; i < nr_pages; i++)
+			LZ4_decompress_safe(dst + i * SLOT_SIZE, out, clen[i],
+					    PAGE_SIZE);
+	ns = ktime_get_ns() - start;
+
+	pr_info("%u pages, ratio %zu%%, decompression %llu MB/s, %llu ns/page\n",
+		nr_pages, total * 100 / (nr_pages * PAGE_SIZE),
+		div64_u64((u64)rounds * nr_pages * PAGE_SIZE * 1000, ns ?: 1),
+		div64_u64(ns, (u64)rounds * nr_pages));
+	pr_info("test passed\n");
+	err = 0;
+out:
+	vfree(clen);
+	vfree(wrkmem);
+	vfree(out);
+	vfree(dst);
+	vfree(src);
+	return err;
+}
+
+static void __exit test_lz4_exit(void)
+{
+}
+
+module_init(test_lz4_init);
+module_exit(test_lz4_exit);
+MODULE_LICENSE("GPL");
@@ -57,6 +57,14 @@ static bool enomem_retry = false;
 module_param(enomem_retry, bool, 0);
 MODULE_PARM_DESC(enomem_retry, "Retry insert even if -ENOMEM was returned (default: off)");
 
+static int grow_threshold = 0;
+module_param(grow_threshold, int, 0);
+MODULE_PARM_DESC(grow_threshold, "Grow threshold in percent (default: 75)");
+
+static int lookups = 4;
+module_param(lookups, int, 0);
+MODULE_PARM_DESC(lookups, "Lookups per insert in the concurrent benchmark (default: 4)");
+
 struct test_obj_val {
 	int	id;
 	int	tid;
@@ -77,6 +85,7 @@ struct thread_data {
 	int id;
 	struct task_struct *task;
 	struct test_obj *objs;
+	s64 duration;
 };
 
 static struct rhashtable_params test_rht_params = {
@@ -561,6 +570,137 @@ static int threadfunc(void *data)
 	return err;
 }
 
+static void test_rht_print_stats(struct rhashtable *ht)
+{
+	struct rhashtable_stats stats;
+
+	rhashtable_get_stats(ht, &stats);
+	pr_info("  nelems=%u size=%u used-buckets=%u max-chain=%u rehashes=%u rehash-time=%llu ns\n",
+		stats.nelems, stats.size, stats.used_buckets, stats.max_chain,
+		stats.rehashes, stats.rehash_ns);
+}
+
+/*
+ * Every thread inserts its own keys and, after each insert, looks up
+ * random keys it inserted earlier, so lookups race with the resizes the
+ * inserts trigger.
+ */
+static int bench_threadfunc(void *data)
+{
+	struct thread_data *tdata = data;
+	unsigned int i, j;
+	int err = 0;
+	s64 start;
+
+	up(&prestart_sem);
+	if (down_interruptible(&startup_sem))
+		pr_err("  thread[%d]: down_interruptible failed\n", tdata->id);
+
+	start = ktime_get_ns();
+	for (i = 0; i < tdata->entries; i++) {
+		tdata->objs[i].value.id = i;
+		tdata->objs[i].value.tid = tdata->id;
+		err = insert_retry(&ht, &tdata->objs[i], test_rht_params);
+		if (err < 0) {
+			pr_err("  thread[%d]: rhashtable_insert_fast failed\n",
+			       tdata->id);
+			goto out;
+		}
+		err = 0;
+
+		for (j = 0; j < lookups; j++) {
+			struct test_obj_val key = {
+				.id = prandom_u32_max(i + 1),
+				.tid = tdata->id,
+			};
+
+			if (!rhashtable_lookup_fast(&ht, &key, test_rht_params)) {
+				pr_err("  thread[%d]: object %d-%d not found\n",
+				       tdata->id, key.tid, key.id);
+				err = -ENOENT;
+				goto out;
+			}
+		}
+	}
+	tdata->duration = ktime_get_ns() - start;
+out:
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		schedule();
+	}
+	return err;
+}
+
+static int __init test_rht_bench(unsigned int entries)
+{
+	struct thread_data *tdata;
+	struct test_obj *objs;
+	s64 duration = 0;
+	u64 ops;
+	int i, err, ret = 0;
+
+	pr_info("Benchmarking concurrent inserts with %d lookups each from %d threads\n",
+		lookups, tcount);
+	sema_init(&prestart_sem, 1 - tcount);
+	sema_init(&startup_sem, 0);
+	tdata = vzalloc(tcount * sizeof(struct thread_data));
+	if (!tdata)
+		return -ENOMEM;
+	objs = vzalloc(tcount * entries * sizeof(struct test_obj));
+	if (!objs) {
+		vfree(tdata);
+		return -ENOMEM;
+	}
+
+	/* Start small so that the inserts have to go through resizes. */
+	test_rht_params.nelem_hint = 0;
+	test_rht_params.max_size = max_size ? :
+				   roundup_pow_of_two(tcount * entries);
+	err = rhashtable_init(&ht, &test_rht_params);
+	if (err < 0) {
+		vfree(tdata);
+		vfree(objs);
+		return err;
+	}
+
+	for (i = 0; i < tcount; i++) {
+		tdata[i].id = i;
+		tdata[i].entries = entries;
+		tdata[i].objs = objs + i * entries;
+		tdata[i].task = kthread_run(bench_threadfunc, &tdata[i],
+					    "rhashtable_bench[%d]", i);
+		if (IS_ERR(tdata[i].task)) {
+			pr_err(" kthread_run failed for thread %d\n", i);
+			/* Keep the prestart count balanced. */
+			up(&prestart_sem);
+		}
+	}
+	if (down_interruptible(&prestart_sem))
+		pr_err("  down interruptible failed\n");
+	for (i = 0; i < tcount; i++)
+		up(&startup_sem);
+	for (i = 0; i < tcount; i++) {
+		if (IS_ERR(tdata[i].task))
+			continue;
+		err = kthread_stop(tdata[i].task);
+		if (err)
+			ret = err;
+		duration = max(duration, tdata[i].duration);
+	}
+
+	test_rht_print_stats(&ht);
+	rhashtable_destroy(&ht);
+
+	ops = (u64)tcount * entries * (lookups + 1);
+	if (!ret && duration > 0)
+		pr_info("  %llu operations in %lld ns, %llu ops/sec\n", ops,
+			duration, div64_u64(ops * NSEC_PER_SEC, duration));
+
+	vfree(tdata);
+	vfree(objs);
+	return ret;
+}
+
 static int __init test_rht_init(void)
 {
 	unsigned int entries;
@@ -575,6 +715,7 @@ static int __init test_rht_init(void)
 	entries = min(parm_entries, MAX_ENTRIES);
 
 	test_rht_params.automatic_shrinking = shrinking;
+	test_rht_params.grow_threshold = grow_threshold;
 	test_rht_params.max_size = max_size ? : roundup_pow_of_two(entries);
 	test_rht_params.nelem_hint = size;
 
@@ -599,6 +740,7 @@ static int __init test_rht_init(void)
 		}
 
 		time = test_rhashtable(&ht, objs, entries);
+		test_rht_print_stats(&ht);
 		rhashtable_destroy(&ht);
 		if (time < 0) {
 			vfree(objs);
@@ -670,6 +812,10 @@ static int __init test_rht_init(void)
 	vfree(tdata);
 	vfree(objs);
 
+	err = test_rht_bench(entries);
+	if (err)
+		pr_warn("Test failed: concurrent benchmark returned: %d\n", err);
+
 	/*
 	 * rhltable_remove is very expensive, default values can cause test
 	 * to run for 2 minutes or more,  use a smaller number instead.
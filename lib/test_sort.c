@@ -1,16 +1,60 @@
 #include <linux/sort.h>
 #include <linux/slab.h>
 #include <linux/module.h>
+#include <linux/ktime.h>
+#include <linux/vmalloc.h>
 
 /* a simple boot-time regression test */
 
 #define TEST_LEN 1000
+#define BENCH_LEN (1 << 20)
 
 static int __init cmpint(const void *a, const void *b)
 {
 	return *(int *)a - *(int *)b;
 }
 
+static int __init cmpu64(const void *a, const void *b)
+{
+	u64 x = *(u64 *)a, y = *(u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Time one sort of @num pseudo-random u64s and check the result. */
+static int __init test_sort_bench(size_t num)
+{
+	u64 *a, r = 1;
+	s64 start, end;
+	size_t i;
+	int err = -ENOMEM;
+
+	a = vmalloc(num * sizeof(*a));
+	if (!a)
+		return err;
+
+	for (i = 0; i < num; i++) {
+		r = r * 6364136223846793005ULL + 1442695040888963407ULL;
+		a[i] = r;
+	}
+
+	start = ktime_get_ns();
+	sort(a, num, sizeof(*a), cmpu64, NULL);
+	end = ktime_get_ns();
+
+	err = -EINVAL;
+	for (i = 0; i < num - 1; i++)
+		if (a[i] > a[i+1]) {
+			pr_err("test has failed for %zu elements\n", num);
+			goto exit;
+		}
+	err = 0;
+	pr_info("sorted %zu u64 elements in %lld ns\n", num, end - start);
+exit:
+	vfree(a);
+	return err;
+}
+
 static int __init test_sort_init(void)
 {
 	int *a, i, r = 1, err = -ENOMEM;
@@ -32,8 +76,9 @@ static int __init test_sort_init(void)
 			pr_err("test has failed\n");
 			goto exit;
 		}
-	err = 0;
-	pr_info("test passed\n");
+	err = test_sort_bench(BENCH_LEN);
+	if (!err)
+		pr_info("test passed\n");
 exit:
 	kfree(a);
 	return err;
@@ -0,0 +1,147 @@
+/*
+ * Test and benchmark for zstd parallel compression
+ *
+ * Compresses a partly compressible buffer once with a single context and
+ * once with ZSTD_compressParallel() on all online CPUs, checks that the
+ * multi-frame result decompresses back to the input, and reports the
+ * throughput and ratio of both.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/random.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/zstd.h>
+
+static unsigned int size_mb = 64;
+module_param(size_mb, uint, 0444);
+MODULE_PARM_DESC(size_mb, "Size of the test buffer in MB (default: 64)");
+
+static unsigned int chunk_kb = 4096;
+module_param(chunk_kb, uint, 0444);
+MODULE_PARM_DESC(chunk_kb, "Size of each parallel chunk in KB (default: 4096)");
+
+static int level = 3;
+module_param(level, int, 0444);
+MODULE_PARM_DESC(level, "zstd compression level (default: 3)");
+
+/* Text-like data: runs of a small alphabet with some random noise */
+static void __init fill_buffer(u8 *buf, size_t len)
+{
+	static const char words[] = "the quick brown fox jumps over a lazy dog ";
+	size_t i;
+
+	prandom_bytes(buf, len);
+	for (i = 0; i < len; i++)
+		if (buf[i] & 0xe0)
+			buf[i] = words[(i * 7 + (buf[i] & 3)) % (sizeof(words) - 1)];
+}
+
+static void __init report(const char *name, size_t len, size_t clen, u64 ns)
+{
+	pr_info("%-9s %zu -> %zu bytes (%zu.%02zu%%), %llu MB/s\n", name, len,
+		clen, clen * 100 / len, clen * 10000 / len % 100,
+		div64_u64((u64)len * 1000, ns ?: 1));
+}
+
+static int __init test_zstd_init(void)
+{
+	size_t len = (size_t)size_mb << 20, chunk = (size_t)chunk_kb << 10;
+	unsigned int workers = num_online_cpus();
+	ZSTD_parameters params, cparams;
+	ZSTD_parallelCtx *pctx;
+	ZSTD_CCtx *cctx;
+	ZSTD_DCtx *dctx;
+	size_t wsize, dstlen, clen;
+	void *ws = NULL;
+	u8 *src, *dst = NULL, *out = NULL;
+	int err = -ENOMEM;
+	u64 start;
+
+	if (!len || !chunk)
+		return -EINVAL;
+
+	src = vmalloc(len);
+	if (!src)
+		return -ENOMEM;
+	fill_buffer(src, len);
+
+	/* Serial baseline: one frame, one context */
+	params = ZSTD_getParams(level, len, 0);
+	dstlen = max(ZSTD_compressBound(len), ZSTD_parallelCompressBound(len, chunk));
+	dst = vmalloc(dstlen);
+	out = vmalloc(len);
+	ws = vmalloc(ZSTD_CCtxWorkspaceBound(params.cParams));
+	if (!dst || !out || !ws)
+		goto out;
+
+	cctx = ZSTD_initCCtx(ws, ZSTD_CCtxWorkspaceBound(params.cParams));
+	start = ktime_get_ns();
+	clen = ZSTD_compressCCtx(cctx, dst, dstlen, src, len, params);
+	if (ZSTD_isError(clen)) {
+		pr_err("serial compression failed: %d\n", ZSTD_getErrorCode(clen));
+		err = -EINVAL;
+		goto out;
+	}
+	report("serial", len, clen, ktime_get_ns() - start);
+	vfree(ws);
+
+	/* Parallel: one frame per chunk, all online CPUs */
+	cparams = ZSTD_getParams(level, chunk, 0);
+	wsize = ZSTD_parallelWorkspaceBound(cparams.cParams, workers);
+	ws = vmalloc(wsize);
+	if (!ws)
+		goto out;
+	pctx = ZSTD_initParallelCtx(cparams, chunk, workers, ws, wsize);
+	if (!pctx) {
+		err = -EINVAL;
+		goto out;
+	}
+
+	start = ktime_get_ns();
+	clen = ZSTD_compressParallel(pctx, dst, dstlen, src, len);
+	if (ZSTD_isError(clen)) {
+		pr_err("parallel compression failed: %d\n", ZSTD_getErrorCode(clen));
+		err = -EINVAL;
+		goto out;
+	}
+	report("parallel", len, clen, ktime_get_ns() - start);
+	vfree(ws);
+
+	/* The concatenated frames must decompress back to the input */
+	wsize = ZSTD_DCtxWorkspaceBound();
+	ws = vmalloc(wsize);
+	if (!ws)
+		goto out;
+	dctx = ZSTD_initDCtx(ws, wsize);
+	if (ZSTD_decompressDCtx(dctx, out, len, dst, clen) != len ||
+	    memcmp(src, out, len)) {
+		pr_err("parallel output does not round-trip\n");
+		err = -EINVAL;
+		goto out;
+	}
+
+	pr_info("test passed with %u workers\n", workers);
+	err = 0;
+out:
+	vfree(ws);
+	vfree(out);
+	vfree(dst);
+	vfree(src);
+	return err;
+}
+
+static void __exit test_zstd_exit(void)
+{
+}
+
+module_init(test_zstd_init);
+module_exit(test_zstd_exit);
+MODULE_LICENSE("GPL");
@@ -0,0 +1,183 @@
+/**
+ * Copyright (c) 2016-present, Yann Collet, Facebook, Inc.
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of https://github.com/facebook/zstd.
+ * An additional grant of patent rights can be found in the PATENTS file in the
+ * same directory.
+ *
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation. This program is dual-licensed; you may select
+ * either version 2 of the GNU General Public License ("GPL") or BSD license
+ * ("BSD").
+ */
+
+/*-*************************************
+*  Dependencies
+***************************************/
+#include "zstd_internal.h" /* includes zstd.h */
+#include <linux/atomic.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/string.h> /* memmove */
+#include <linux/workqueue.h>
+
+/*-*************************************
+*  Parallel compression
+*
+*  The input is cut into chunks of chunkSize bytes, and every chunk is
+*  compressed into an independent frame by one of nbWorkers contexts.
+*  Concatenated frames form a valid zstd stream, so the result can be
+*  decompressed with ZSTD_decompressDCtx() or the streaming API as usual.
+***************************************/
+struct ZSTD_parallelCtx_s {
+	ZSTD_parameters params;
+	size_t chunkSize;
+	unsigned int nbWorkers;
+	ZSTD_CCtx *cctx[];
+};
+
+typedef struct {
+	struct work_struct work;
+	const ZSTD_parallelCtx *pctx;
+	ZSTD_CCtx *cctx;
+	atomic_t *nextChunk;
+	unsigned int nbChunks;
+	const BYTE *src;
+	size_t srcSize;
+	BYTE *dst;
+	size_t slotSize;
+	size_t *cSizes;
+} ZSTD_parallelJob;
+
+static size_t ZSTD_parallelCtxSize(unsigned int nbWorkers)
+{
+	return ZSTD_ALIGN(sizeof(ZSTD_parallelCtx) + nbWorkers * sizeof(ZSTD_CCtx *));
+}
+
+size_t ZSTD_parallelWorkspaceBound(ZSTD_compressionParameters cParams, unsigned int nbWorkers)
+{
+	return ZSTD_parallelCtxSize(nbWorkers) + nbWorkers * ZSTD_ALIGN(ZSTD_CCtxWorkspaceBound(cParams));
+}
+
+ZSTD_parallelCtx *ZSTD_initParallelCtx(ZSTD_parameters params, size_t chunkSize, unsigned int nbWorkers, void *workspace, size_t workspaceSize)
+{
+	size_t const cctxSize = ZSTD_ALIGN(ZSTD_CCtxWorkspaceBound(params.cParams));
+	ZSTD_parallelCtx *pctx;
+	BYTE *ws = (BYTE *)workspace;
+	unsigned int i;
+
+	if (!nbWorkers || !chunkSize || workspaceSize < ZSTD_parallelWorkspaceBound(params.cParams, nbWorkers))
+		return NULL;
+	if ((size_t)ws != ZSTD_ALIGN((size_t)ws))
+		return NULL;
+
+	pctx = (ZSTD_parallelCtx *)ws;
+	pctx->params = params;
+	pctx->chunkSize = chunkSize;
+	pctx->nbWorkers = nbWorkers;
+	ws += ZSTD_parallelCtxSize(nbWorkers);
+
+	for (i = 0; i < nbWorkers; i++, ws += cctxSize) {
+		pctx->cctx[i] = ZSTD_initCCtx(ws, cctxSize);
+		if (!pctx->cctx[i])
+			return NULL;
+	}
+	return pctx;
+}
+
+static size_t ZSTD_parallelNbChunks(size_t srcSize, size_t chunkSize)
+{
+	/* An empty input still produces one (empty) frame */
+	return srcSize ? DIV_ROUND_UP(srcSize, chunkSize) : 1;
+}
+
+size_t ZSTD_parallelCompressBound(size_t srcSize, size_t chunkSize)
+{
+	return ZSTD_parallelNbChunks(srcSize, chunkSize) * ZSTD_compressBound(chunkSize);
+}
+
+static void ZSTD_parallelCompressChunks(ZSTD_parallelJob *job)
+{
+	size_t const chunkSize = job->pctx->chunkSize;
+	unsigned int chunk;
+
+	while ((chunk = atomic_inc_return(job->nextChunk) - 1) < job->nbChunks) {
+		size_t const start = (size_t)chunk * chunkSize;
+		size_t const len = MIN(chunkSize, job->srcSize - start);
+
+		job->cSizes[chunk] = ZSTD_compressCCtx(job->cctx, job->dst + chunk * job->slotSize, job->slotSize, job->src + start, len, job->pctx->params);
+		cond_resched();
+	}
+}
+
+static void ZSTD_parallelWork(struct work_struct *work)
+{
+	ZSTD_parallelCompressChunks(container_of(work, ZSTD_parallelJob, work));
+}
+
+size_t ZSTD_compressParallel(ZSTD_parallelCtx *pctx, void *dst, size_t dstCapacity, const void *src, size_t srcSize)
+{
+	size_t const nbChunks = ZSTD_parallelNbChunks(srcSize, pctx->chunkSize);
+	size_t const slotSize = ZSTD_compressBound(pctx->chunkSize);
+	unsigned int const nbJobs = MIN(pctx->nbWorkers, nbChunks);
+	ZSTD_parallelJob *jobs;
+	atomic_t nextChunk = ATOMIC_INIT(0);
+	size_t *cSizes;
+	BYTE *op = (BYTE *)dst;
+	size_t ret;
+	unsigned int i;
+
+	might_sleep();
+
+	if (nbChunks > UINT_MAX || dstCapacity / slotSize < nbChunks)
+		return ERROR(dstSize_tooSmall);
+
+	jobs = kmalloc(nbJobs * sizeof(*jobs) + nbChunks * sizeof(*cSizes), GFP_KERNEL);
+	if (!jobs)
+		return ERROR(memory_allocation);
+	cSizes = (size_t *)(jobs + nbJobs);
+
+	/* Every chunk is compressed into its own slot of dst, then compacted */
+	for (i = 0; i < nbJobs; i++) {
+		jobs[i].pctx = pctx;
+		jobs[i].cctx = pctx->cctx[i];
+		jobs[i].nextChunk = &nextChunk;
+		jobs[i].nbChunks = nbChunks;
+		jobs[i].src = (const BYTE *)src;
+		jobs[i].srcSize = srcSize;
+		jobs[i].dst = op;
+		jobs[i].slotSize = slotSize;
+		jobs[i].cSizes = cSizes;
+		INIT_WORK(&jobs[i].work, ZSTD_parallelWork);
+	}
+
+	/* The caller compresses with the first context itself */
+	for (i = 1; i < nbJobs; i++)
+		queue_work(system_unbound_wq, &jobs[i].work);
+	ZSTD_parallelCompressChunks(&jobs[0]);
+	for (i = 1; i < nbJobs; i++)
+		flush_work(&jobs[i].work);
+
+	for (i = 0; i < nbChunks; i++) {
+		if (ZSTD_isError(cSizes[i])) {
+			ret = cSizes[i];
+			goto out;
+		}
+		/* op never overtakes the start of slot i, so this is safe */
+		memmove(op, (BYTE *)dst + (size_t)i * slotSize, cSizes[i]);
+		op += cSizes[i];
+	}
+	ret = op - (BYTE *)dst;
+out:
+	kfree(jobs);
+	return ret;
+}
+
+EXPORT_SYMBOL(ZSTD_parallelWorkspaceBound);
+EXPORT_SYMBOL(ZSTD_initParallelCtx);
+EXPORT_SYMBOL(ZSTD_parallelCompressBound);
+EXPORT_SYMBOL(ZSTD_compressParallel);
@@ -278,8 +278,15 @@ void arch_tlb_finish_mmu(struct mmu_gather *tlb,
 {
 	struct mmu_gather_batch *batch, *next;
 
-	if (force)
+	if (force) {
+		/*
+		 * The range now also covers entries cleared by the other
+		 * threads, which may be base pages even if this gather only
+		 * saw huge ones, so flush it at the smallest stride.
+		 */
+		tlb->page_size = 0;
 		__tlb_adjust_range(tlb, start, end - start);
+	}
 
 	tlb_flush_mmu(tlb);
 
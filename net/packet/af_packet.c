@@ -89,6 +89,9 @@
 #include <linux/errqueue.h>
 #include <linux/net_tstamp.h>
 #include <linux/percpu.h>
+#include <linux/hash.h>
+#include <linux/jhash.h>
+#include <linux/bitmap.h>
 #ifdef CONFIG_INET
 #include <net/inet_common.h>
 #endif
@@ -1184,6 +1187,66 @@ static void packet_increment_head(struct packet_ring_buffer *buff)
 	buff->head = buff->head != buff->frame_max ? buff->head+1 : 0;
 }
 
+/* The TPACKET_V3 TX ring is walked block by block.  Within a block a
+ * frame may set tp_next_offset to the distance to the following frame,
+ * which lets variable sized frames be packed back to back; without it
+ * frames are tp_frame_size apart, as with V1/V2.  Once less than
+ * tp_frame_size is left in a block, the next frame is at the start of
+ * the following block.
+ */
+static void *packet_current_tx_frame(struct packet_sock *po, int status)
+{
+	struct packet_ring_buffer *rb = &po->tx_ring;
+	void *frame;
+
+	if (po->tp_version != TPACKET_V3)
+		return packet_current_frame(po, rb, status);
+
+	frame = rb->pg_vec[rb->head].buffer + rb->head_offset;
+	if (status != __packet_get_status(po, frame))
+		return NULL;
+
+	return frame;
+}
+
+/* Size of the slot @frame may use, 0 if its tp_next_offset is bogus */
+static unsigned int packet_tx_frame_slot(struct packet_sock *po, void *frame)
+{
+	struct packet_ring_buffer *rb = &po->tx_ring;
+	unsigned int next, room;
+
+	if (po->tp_version != TPACKET_V3)
+		return rb->frame_size;
+
+	next = READ_ONCE(((struct tpacket3_hdr *)frame)->tp_next_offset);
+	if (!next)
+		return rb->frame_size;
+
+	room = (rb->pg_vec_pages << PAGE_SHIFT) - rb->head_offset;
+	if (unlikely(next & (TPACKET_ALIGNMENT - 1) ||
+		     next < po->tp_hdrlen || next > room))
+		return 0;
+
+	return next;
+}
+
+static void packet_increment_tx_head(struct packet_sock *po,
+				     unsigned int slot)
+{
+	struct packet_ring_buffer *rb = &po->tx_ring;
+	unsigned int blk_size;
+
+	if (po->tp_version != TPACKET_V3)
+		return packet_increment_head(rb);
+
+	blk_size = rb->pg_vec_pages << PAGE_SHIFT;
+	rb->head_offset += slot ? : rb->frame_size;
+	if (blk_size - rb->head_offset < rb->frame_size) {
+		rb->head_offset = 0;
+		rb->head = rb->head != rb->pg_vec_len - 1 ? rb->head + 1 : 0;
+	}
+}
+
 static void packet_inc_pending(struct packet_ring_buffer *rb)
 {
 	this_cpu_inc(*rb->pending_refcnt);
@@ -1338,6 +1401,22 @@ static unsigned int fanout_demux_hash(struct packet_fanout *f,
 	return reciprocal_scale(__skb_get_hash_symmetric(skb), num);
 }
 
+static unsigned int fanout_demux_chash(struct packet_fanout *f,
+				       struct sk_buff *skb,
+				       unsigned int num)
+{
+	u32 rxhash = __skb_get_hash_symmetric(skb);
+	unsigned int idx;
+
+	idx = reciprocal_scale(rxhash, PACKET_FANOUT_CHASH_SIZE);
+	idx = READ_ONCE(f->chash->table[idx]);
+
+	/* The table trails a member leaving by one rebuild */
+	if (unlikely(idx >= num))
+		idx = reciprocal_scale(rxhash, num);
+	return idx;
+}
+
 static unsigned int fanout_demux_lb(struct packet_fanout *f,
 				    struct sk_buff *skb,
 				    unsigned int num)
@@ -1452,6 +1531,9 @@ static int packet_rcv_fanout(struct sk_buff *skb, struct net_device *dev,
 	default:
 		idx = fanout_demux_hash(f, skb, num);
 		break;
+	case PACKET_FANOUT_CHASH:
+		idx = fanout_demux_chash(f, skb, num);
+		break;
 	case PACKET_FANOUT_LB:
 		idx = fanout_demux_lb(f, skb, num);
 		break;
@@ -1485,6 +1567,58 @@ EXPORT_SYMBOL_GPL(fanout_mutex);
 static LIST_HEAD(fanout_list);
 static u16 fanout_next_id;
 
+/* Repopulate the PACKET_FANOUT_CHASH lookup table after a membership
+ * change, Maglev style (Eisenbud et al., NSDI 2016). Every member walks
+ * its own permutation of the slots, seeded from its socket rather than
+ * from its position in f->arr, and the members take turns claiming the
+ * next free slot on their walk. Each member ends up with an equal share
+ * of the slots, and a join or leave moves little more than the 1/N of
+ * the flows that must move.
+ *
+ * Called with f->lock held. The table is updated in place: a reader
+ * racing with the rebuild may see a mix of old and new slots, which
+ * only affects flows that are being moved anyway.
+ */
+static void fanout_chash_rebuild(struct packet_fanout *f)
+{
+	struct packet_fanout_chash *ch = f->chash;
+	unsigned int num = f->num_members;
+	unsigned int i, slot, filled = 0;
+
+	if (!num)
+		return;
+
+	for (i = 0; i < num; i++) {
+		u32 key = hash_ptr(f->arr[i], 32);
+
+		ch->next[i] = jhash_1word(key, 0) % PACKET_FANOUT_CHASH_SIZE;
+		ch->skip[i] = jhash_1word(key, 1) %
+			      (PACKET_FANOUT_CHASH_SIZE - 1) + 1;
+	}
+	bitmap_zero(ch->taken, PACKET_FANOUT_CHASH_SIZE);
+
+	for (;;) {
+		for (i = 0; i < num; i++) {
+			slot = ch->next[i];
+			while (test_bit(slot, ch->taken)) {
+				slot += ch->skip[i];
+				if (slot >= PACKET_FANOUT_CHASH_SIZE)
+					slot -= PACKET_FANOUT_CHASH_SIZE;
+			}
+			__set_bit(slot, ch->taken);
+			WRITE_ONCE(ch->table[slot], i);
+
+			slot += ch->skip[i];
+			if (slot >= PACKET_FANOUT_CHASH_SIZE)
+				slot -= PACKET_FANOUT_CHASH_SIZE;
+			ch->next[i] = slot;
+
+			if (++filled == PACKET_FANOUT_CHASH_SIZE)
+				return;
+		}
+	}
+}
+
 static void __fanout_link(struct sock *sk, struct packet_sock *po)
 {
 	struct packet_fanout *f = po->fanout;
@@ -1495,6 +1629,8 @@ static void __fanout_link(struct sock *sk, struct packet_sock *po)
 	f->num_members++;
 	if (f->num_members == 1)
 		dev_add_pack(&f->prot_hook);
+	if (f->type == PACKET_FANOUT_CHASH)
+		fanout_chash_rebuild(f);
 	spin_unlock(&f->lock);
 }
 
@@ -1513,6 +1649,8 @@ static void __fanout_unlink(struct sock *sk, struct packet_sock *po)
 	f->num_members--;
 	if (f->num_members == 0)
 		__dev_remove_pack(&f->prot_hook);
+	if (f->type == PACKET_FANOUT_CHASH)
+		fanout_chash_rebuild(f);
 	spin_unlock(&f->lock);
 }
 
@@ -1524,7 +1662,7 @@ static bool match_fanout_group(struct packet_type *ptype, struct sock *sk)
 	return ptype->af_packet_priv == pkt_sk(sk)->fanout;
 }
 
-static void fanout_init_data(struct packet_fanout *f)
+static int fanout_init_data(struct packet_fanout *f)
 {
 	switch (f->type) {
 	case PACKET_FANOUT_LB:
@@ -1534,7 +1672,13 @@ static void fanout_init_data(struct packet_fanout *f)
 	case PACKET_FANOUT_EBPF:
 		RCU_INIT_POINTER(f->bpf_prog, NULL);
 		break;
+	case PACKET_FANOUT_CHASH:
+		f->chash = kvzalloc(sizeof(*f->chash), GFP_KERNEL);
+		if (!f->chash)
+			return -ENOMEM;
+		break;
 	}
+	return 0;
 }
 
 static void __fanout_set_data_bpf(struct packet_fanout *f, struct bpf_prog *new)
@@ -1614,6 +1758,11 @@ static void fanout_release_data(struct packet_fanout *f)
 	case PACKET_FANOUT_CBPF:
 	case PACKET_FANOUT_EBPF:
 		__fanout_set_data_bpf(f, NULL);
+		break;
+	case PACKET_FANOUT_CHASH:
+		kvfree(f->chash);
+		f->chash = NULL;
+		break;
 	};
 }
 
@@ -1667,6 +1816,7 @@ static int fanout_add(struct sock *sk, u16 id, u16 type_flags)
 	case PACKET_FANOUT_QM:
 	case PACKET_FANOUT_CBPF:
 	case PACKET_FANOUT_EBPF:
+	case PACKET_FANOUT_CHASH:
 		break;
 	default:
 		return -EINVAL;
@@ -1725,7 +1875,10 @@ static int fanout_add(struct sock *sk, u16 id, u16 type_flags)
 		INIT_LIST_HEAD(&match->list);
 		spin_lock_init(&match->lock);
 		refcount_set(&match->sk_ref, 0);
-		fanout_init_data(match);
+		if (fanout_init_data(match)) {
+			kfree(match);
+			goto out;
+		}
 		match->prot_hook.type = po->prot_hook.type;
 		match->prot_hook.dev = po->prot_hook.dev;
 		match->prot_hook.func = packet_rcv_fanout;
@@ -1755,6 +1908,7 @@ static int fanout_add(struct sock *sk, u16 id, u16 type_flags)
 
 	if (err && !refcount_read(&match->sk_ref)) {
 		list_del(&match->list);
+		fanout_release_data(match);
 		kfree(match);
 	}
 
@@ -2548,7 +2702,7 @@ static int tpacket_fill_skb(struct packet_sock *po, struct sk_buff *skb,
 }
 
 static int tpacket_parse_header(struct packet_sock *po, void *frame,
-				int size_max, void **data)
+				unsigned int slot, int size_max, void **data)
 {
 	union tpacket_uhdr ph;
 	int tp_len, off;
@@ -2557,10 +2711,8 @@ static int tpacket_parse_header(struct packet_sock *po, void *frame,
 
 	switch (po->tp_version) {
 	case TPACKET_V3:
-		if (ph.h3->tp_next_offset != 0) {
-			pr_warn_once("variable sized slot not supported");
+		if (unlikely(!slot))
 			return -EINVAL;
-		}
 		tp_len = ph.h3->tp_len;
 		break;
 	case TPACKET_V2:
@@ -2579,7 +2731,7 @@ static int tpacket_parse_header(struct packet_sock *po, void *frame,
 		int off_min, off_max;
 
 		off_min = po->tp_hdrlen - sizeof(struct sockaddr_ll);
-		off_max = po->tx_ring.frame_size - tp_len;
+		off_max = (int)slot - tp_len;
 		if (po->sk.sk_type == SOCK_DGRAM) {
 			switch (po->tp_version) {
 			case TPACKET_V3:
@@ -2609,6 +2761,8 @@ static int tpacket_parse_header(struct packet_sock *po, void *frame,
 			return -EINVAL;
 	} else {
 		off = po->tp_hdrlen - sizeof(struct sockaddr_ll);
+		if (unlikely(off + tp_len > slot))
+			return -EMSGSIZE;
 	}
 
 	*data = frame + off;
@@ -2627,6 +2781,7 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 	DECLARE_SOCKADDR(struct sockaddr_ll *, saddr, msg->msg_name);
 	bool need_wait = !(msg->msg_flags & MSG_DONTWAIT);
 	int tp_len, size_max;
+	unsigned int slot = 0;
 	unsigned char *addr;
 	void *data;
 	int len_sum = 0;
@@ -2668,15 +2823,16 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 
 	if (po->sk.sk_socket->type == SOCK_RAW)
 		reserve = dev->hard_header_len;
-	size_max = po->tx_ring.frame_size
-		- (po->tp_hdrlen - sizeof(struct sockaddr_ll));
+	size_max = po->tx_ring.frame_size;
+	if (po->tp_version == TPACKET_V3)
+		size_max = po->tx_ring.pg_vec_pages << PAGE_SHIFT;
+	size_max -= po->tp_hdrlen - sizeof(struct sockaddr_ll);
 
 	if ((size_max > dev->mtu + reserve + VLAN_HLEN) && !po->has_vnet_hdr)
 		size_max = dev->mtu + reserve + VLAN_HLEN;
 
 	do {
-		ph = packet_current_frame(po, &po->tx_ring,
-					  TP_STATUS_SEND_REQUEST);
+		ph = packet_current_tx_frame(po, TP_STATUS_SEND_REQUEST);
 		if (unlikely(ph == NULL)) {
 			if (need_wait && need_resched())
 				schedule();
@@ -2684,7 +2840,8 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 		}
 
 		skb = NULL;
-		tp_len = tpacket_parse_header(po, ph, size_max, &data);
+		slot = packet_tx_frame_slot(po, ph);
+		tp_len = tpacket_parse_header(po, ph, slot, size_max, &data);
 		if (tp_len < 0)
 			goto tpacket_error;
 
@@ -2728,7 +2885,7 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 			if (po->tp_loss) {
 				__packet_set_status(po, ph,
 						TP_STATUS_AVAILABLE);
-				packet_increment_head(&po->tx_ring);
+				packet_increment_tx_head(po, slot);
 				kfree_skb(skb);
 				continue;
 			} else {
@@ -2764,7 +2921,7 @@ static int tpacket_snd(struct packet_sock *po, struct msghdr *msg)
 			 */
 			err = 0;
 		}
-		packet_increment_head(&po->tx_ring);
+		packet_increment_tx_head(po, slot);
 		len_sum += tp_len;
 	} while (likely((ph != NULL) ||
 		/* Note: packet_read_pending() might be slow if we have
@@ -4091,7 +4248,7 @@ static unsigned int packet_poll(struct file *file, struct socket *sock,
 	spin_unlock_bh(&sk->sk_receive_queue.lock);
 	spin_lock_bh(&sk->sk_write_queue.lock);
 	if (po->tx_ring.pg_vec) {
-		if (packet_current_frame(po, &po->tx_ring, TP_STATUS_AVAILABLE))
+		if (packet_current_tx_frame(po, TP_STATUS_AVAILABLE))
 			mask |= POLLOUT | POLLWRNORM;
 	}
 	spin_unlock_bh(&sk->sk_write_queue.lock);
@@ -4271,7 +4428,9 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 			goto out;
 		switch (po->tp_version) {
 		case TPACKET_V3:
-			/* Block transmit is not supported yet */
+			/* The TX ring has no block descriptors or retire
+			 * timer, frames are walked by packet_current_tx_frame()
+			 */
 			if (!tx_ring) {
 				init_prb_bdqc(po, rb, pg_vec, req_u);
 			} else {
@@ -4317,6 +4476,7 @@ static int packet_set_ring(struct sock *sk, union tpacket_req_u *req_u,
 		swap(rb->pg_vec, pg_vec);
 		rb->frame_max = (req->tp_frame_nr - 1);
 		rb->head = 0;
+		rb->head_offset = 0;
 		rb->frame_size = req->tp_frame_size;
 		spin_unlock_bh(&rb_queue->lock);
 
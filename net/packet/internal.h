@@ -60,6 +60,8 @@ struct packet_ring_buffer {
 	struct pgv		*pg_vec;
 
 	unsigned int		head;
+	/* TPACKET_V3 TX: offset of the head frame in block head */
+	unsigned int		head_offset;
 	unsigned int		frames_per_block;
 	unsigned int		frame_size;
 	unsigned int		frame_max;
@@ -76,6 +78,19 @@ struct packet_ring_buffer {
 extern struct mutex fanout_mutex;
 #define PACKET_FANOUT_MAX	256
 
+/* Lookup table for PACKET_FANOUT_CHASH. The size must be prime, so that
+ * every skip in [1, size - 1] walks all slots, and much larger than
+ * PACKET_FANOUT_MAX to keep the per-member share of slots even.
+ */
+#define PACKET_FANOUT_CHASH_SIZE	8191
+
+struct packet_fanout_chash {
+	u32			next[PACKET_FANOUT_MAX];
+	u32			skip[PACKET_FANOUT_MAX];
+	DECLARE_BITMAP(taken, PACKET_FANOUT_CHASH_SIZE);
+	u8			table[PACKET_FANOUT_CHASH_SIZE];
+};
+
 struct packet_fanout {
 	possible_net_t		net;
 	unsigned int		num_members;
@@ -85,6 +100,7 @@ struct packet_fanout {
 	union {
 		atomic_t		rr_cur;
 		struct bpf_prog __rcu	*bpf_prog;
+		struct packet_fanout_chash *chash;
 	};
 	struct list_head	list;
 	struct sock		*arr[PACKET_FANOUT_MAX];
@@ -79,7 +79,7 @@
 #include <linux/file.h>
 #include <linux/proc_fs.h>
 #include <linux/mutex.h>
-#include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #include <net/sock.h>
 #include <net/af_unix.h>
@@ -91,10 +91,17 @@
 static LIST_HEAD(gc_inflight_list);
 static LIST_HEAD(gc_candidates);
 static DEFINE_SPINLOCK(unix_gc_lock);
-static DECLARE_WAIT_QUEUE_HEAD(unix_gc_wait);
 
 unsigned int unix_tot_inflight;
 
+/* A cycle of in-flight sockets can only form once a socket carried by
+ * an skb sits on the receive queue of another in-flight socket, or of
+ * an embryo hanging off an in-flight listener. Until that has happened
+ * there is nothing for the collector to find. The flag is set when it
+ * might have happened and stays set until no socket is in flight.
+ */
+static bool unix_graph_maybe_cyclic;
+
 struct sock *unix_get_socket(struct file *filp)
 {
 	struct sock *u_sock = NULL;
@@ -132,6 +139,12 @@ void unix_inflight(struct user_struct *user, struct file *fp)
 			BUG_ON(list_empty(&u->link));
 		}
 		unix_tot_inflight++;
+
+		/* atomic_long_inc_return() above is fully ordered and
+		 * pairs with smp_mb() in unix_gc_queued().
+		 */
+		if (!skb_queue_empty(&s->sk_receive_queue))
+			WRITE_ONCE(unix_graph_maybe_cyclic, true);
 	}
 	user->unix_inflight++;
 	spin_unlock(&unix_gc_lock);
@@ -151,12 +164,45 @@ void unix_notinflight(struct user_struct *user, struct file *fp)
 
 		if (atomic_long_dec_and_test(&u->inflight))
 			list_del_init(&u->link);
-		unix_tot_inflight--;
+		if (!--unix_tot_inflight)
+			WRITE_ONCE(unix_graph_maybe_cyclic, false);
 	}
 	user->unix_inflight--;
 	spin_unlock(&unix_gc_lock);
 }
 
+static bool unix_fp_has_sockets(struct scm_fp_list *fpl)
+{
+	int i;
+
+	for (i = 0; i < fpl->count; i++)
+		if (unix_get_socket(fpl->fp[i]))
+			return true;
+	return false;
+}
+
+static bool gc_in_progress;
+
+/* Called by the sender right after queueing an skb that carries @fpl
+ * onto @other, with other's state lock held.
+ */
+void unix_gc_queued(struct sock *other, struct scm_fp_list *fpl)
+{
+	if (!fpl || READ_ONCE(unix_graph_maybe_cyclic) ||
+	    !unix_fp_has_sockets(fpl))
+		return;
+
+	/* Pairs with atomic_long_inc_return() in unix_inflight() */
+	smp_mb();
+	if (!atomic_long_read(&unix_sk(other)->inflight)) {
+		/* The collector may have dropped the count for a moment */
+		smp_rmb();
+		if (other->sk_socket && !READ_ONCE(gc_in_progress))
+			return;
+	}
+	WRITE_ONCE(unix_graph_maybe_cyclic, true);
+}
+
 static void scan_inflight(struct sock *x, void (*func)(struct unix_sock *),
 			  struct sk_buff_head *hitlist)
 {
@@ -254,21 +300,44 @@ static void inc_inflight_move_tail(struct unix_sock *u)
 		list_move_tail(&u->link, &gc_candidates);
 }
 
-static bool gc_in_progress;
+static void __unix_gc(struct work_struct *work);
+static DECLARE_WORK(unix_gc_work, __unix_gc);
+
 #define UNIX_INFLIGHT_TRIGGER_GC 16000
+#define UNIX_INFLIGHT_SANE_USER (SCM_MAX_FD * 8)
 
-void wait_for_unix_gc(void)
+void wait_for_unix_gc(struct scm_fp_list *fpl)
 {
 	/* If number of inflight sockets is insane,
-	 * force a garbage collect right now.
+	 * kick a garbage collect right now.
 	 */
-	if (unix_tot_inflight > UNIX_INFLIGHT_TRIGGER_GC && !gc_in_progress)
+	if (READ_ONCE(unix_tot_inflight) > UNIX_INFLIGHT_TRIGGER_GC &&
+	    !READ_ONCE(gc_in_progress))
 		unix_gc();
-	wait_event(unix_gc_wait, gc_in_progress == false);
+
+	/* Only a sender that keeps adding sockets while it already has
+	 * many fds in flight waits for the collector to catch up.
+	 */
+	if (!fpl ||
+	    READ_ONCE(fpl->user->unix_inflight) < UNIX_INFLIGHT_SANE_USER ||
+	    !unix_fp_has_sockets(fpl))
+		return;
+
+	if (READ_ONCE(gc_in_progress))
+		flush_work(&unix_gc_work);
 }
 
 /* The external entry point: unix_gc() */
 void unix_gc(void)
+{
+	if (!READ_ONCE(unix_graph_maybe_cyclic))
+		return;
+
+	WRITE_ONCE(gc_in_progress, true);
+	queue_work(system_unbound_wq, &unix_gc_work);
+}
+
+static void __unix_gc(struct work_struct *work)
 {
 	struct unix_sock *u;
 	struct unix_sock *next;
@@ -278,11 +347,11 @@ void unix_gc(void)
 
 	spin_lock(&unix_gc_lock);
 
-	/* Avoid a recursive GC. */
-	if (gc_in_progress)
-		goto out;
+	/* A previous run may have cleared the flag after we were queued. */
+	WRITE_ONCE(gc_in_progress, true);
+	/* Order it before dec_inflight(), pairs with unix_gc_queued() */
+	smp_wmb();
 
-	gc_in_progress = true;
 	/* First, select candidates for garbage collection.  Only
 	 * in-flight sockets are considered, and from those only ones
 	 * which don't have any external reference.
@@ -368,9 +437,7 @@ void unix_gc(void)
 
 	/* All candidates should have been detached by now. */
 	BUG_ON(!list_empty(&gc_candidates));
-	gc_in_progress = false;
-	wake_up(&unix_gc_wait);
+	WRITE_ONCE(gc_in_progress, false);
 
- out:
 	spin_unlock(&unix_gc_lock);
 }
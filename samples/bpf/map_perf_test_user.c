@@ -47,6 +47,7 @@ enum test_type {
 	ARRAY_LOOKUP,
 	INNER_LRU_HASH_PREALLOC,
 	LRU_HASH_LOOKUP,
+	LRU_HASH_SCALING,
 	NR_TESTS,
 };
 
@@ -62,6 +63,7 @@ const char *test_map_names[NR_TESTS] = {
 	[ARRAY_LOOKUP] = "array_map",
 	[INNER_LRU_HASH_PREALLOC] = "inner_lru_hash_map",
 	[LRU_HASH_LOOKUP] = "lru_hash_lookup_map",
+	[LRU_HASH_SCALING] = "lru_hash_map",
 };
 
 static int test_flags = ~0;
@@ -216,6 +218,59 @@ static void test_lru_hash_lookup(int cpu)
 	do_test_lru(LRU_HASH_LOOKUP, cpu);
 }
 
+/* Aggregated lru_hash_map update rate with 1, 2, 4, ... up to
+ * max_tasks CPUs hammering the map at the same time.  It shows
+ * how well the common LRU list scales with the number of CPUs.
+ */
+static void run_lru_scaling_test(int max_tasks)
+{
+	struct sockaddr_in6 in6 = { .sin6_family = AF_INET6 };
+	__u64 start_time;
+	int tasks, i, j;
+
+	in6.sin6_addr.s6_addr16[0] = 0xdead;
+	in6.sin6_addr.s6_addr16[1] = 0xbeef;
+	in6.sin6_addr.s6_addr16[2] = 0;
+
+	for (tasks = 1; tasks <= max_tasks; tasks <<= 1) {
+		pid_t pid[tasks];
+
+		start_time = time_get_ns();
+		for (i = 0; i < tasks; i++) {
+			pid[i] = fork();
+			if (pid[i] == 0) {
+				cpu_set_t cpuset;
+				int ret;
+
+				CPU_ZERO(&cpuset);
+				CPU_SET(i, &cpuset);
+				sched_setaffinity(0, sizeof(cpuset), &cpuset);
+
+				for (j = 0; j < max_cnt; j++) {
+					ret = connect(-1,
+						      (const struct sockaddr *)&in6,
+						      sizeof(in6));
+					assert(ret == -1 && errno == EBADF);
+				}
+				exit(0);
+			} else if (pid[i] == -1) {
+				printf("couldn't spawn #%d process\n", i);
+				exit(1);
+			}
+		}
+		for (i = 0; i < tasks; i++) {
+			int status;
+
+			assert(waitpid(pid[i], &status, 0) == pid[i]);
+			assert(status == 0);
+		}
+
+		printf("%d cpus:lru_hash_map_update_perf %lld events per sec\n",
+		       tasks, (long long)tasks * max_cnt * 1000000000ll /
+		       (time_get_ns() - start_time));
+	}
+}
+
 static void test_percpu_hash_prealloc(int cpu)
 {
 	__u64 start_time;
@@ -334,7 +389,7 @@ static void loop(int cpu)
 	sched_setaffinity(0, sizeof(cpuset), &cpuset);
 
 	for (i = 0; i < NR_TESTS; i++) {
-		if (check_test_flags(i))
+		if (test_funcs[i] && check_test_flags(i))
 			test_funcs[i](cpu);
 	}
 }
@@ -460,5 +515,8 @@ int main(int argc, char **argv)
 
 	run_perf_test(num_cpu);
 
+	if (check_test_flags(LRU_HASH_SCALING))
+		run_lru_scaling_test(num_cpu);
+
 	return 0;
 }
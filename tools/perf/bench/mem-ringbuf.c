@@ -0,0 +1,180 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * mem-ringbuf.c
+ *
+ * ringbuf: Benchmark for writing samples into the perf ring buffer
+ *
+ * A software page fault event with a sample period of 1 is attached to
+ * the benchmark itself, so that every fault on a freshly zapped page
+ * writes one sample.  The samples are consumed from the mmap()ed ring
+ * buffer in place, the way perf record does.
+ */
+#include "../perf.h"
+#include "../util/util.h"
+#include <subcmd/parse-options.h>
+#include "../builtin.h"
+#include "bench.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <linux/time64.h>
+
+#define BATCH_PAGES	256
+
+static unsigned int	mmap_pages = 16384;	/* 64MB with 4K pages */
+static unsigned int	nr_samples = 1000000;
+
+static const struct option options[] = {
+	OPT_UINTEGER('m', "mmap-pages", &mmap_pages, "Number of ring buffer data pages (power of 2)"),
+	OPT_UINTEGER('l', "samples",    &nr_samples, "Number of samples to write"),
+	OPT_END()
+};
+
+static const char * const bench_mem_ringbuf_usage[] = {
+	"perf bench mem ringbuf <options>",
+	NULL
+};
+
+struct ringbuf_stats {
+	u64	samples;
+	u64	lost;
+	u64	bytes;
+};
+
+static void ringbuf_consume(struct perf_event_mmap_page *pc, void *data,
+			    u64 data_size, struct ringbuf_stats *stats)
+{
+	u64 head, tail = pc->data_tail;
+
+	head = READ_ONCE(pc->data_head);
+	rmb();
+
+	while (tail < head) {
+		struct perf_event_header *hdr;
+
+		hdr = data + (tail & (data_size - 1));
+		if (hdr->type == PERF_RECORD_SAMPLE)
+			stats->samples++;
+		else if (hdr->type == PERF_RECORD_LOST)
+			stats->lost += ((u64 *)(hdr + 1))[1];
+		stats->bytes += hdr->size;
+		tail += hdr->size;
+	}
+
+	mb();
+	pc->data_tail = tail;
+}
+
+int bench_mem_ringbuf(int argc, const char **argv)
+{
+	struct perf_event_attr attr = {
+		.type		= PERF_TYPE_SOFTWARE,
+		.config		= PERF_COUNT_SW_PAGE_FAULTS,
+		.size		= sizeof(attr),
+		.sample_period	= 1,
+		.sample_type	= PERF_SAMPLE_IP | PERF_SAMPLE_TID |
+				  PERF_SAMPLE_TIME | PERF_SAMPLE_ADDR,
+		.disabled	= 1,
+		.exclude_kernel	= 1,
+		.exclude_hv	= 1,
+	};
+	struct ringbuf_stats stats = { 0 };
+	struct timeval start, stop, diff;
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	u64 data_size, result_usec;
+	void *base, *buf;
+	unsigned int i;
+	int fd;
+
+	argc = parse_options(argc, argv, options, bench_mem_ringbuf_usage, 0);
+	if (argc)
+		usage_with_options(bench_mem_ringbuf_usage, options);
+
+	if (!mmap_pages || mmap_pages & (mmap_pages - 1)) {
+		fprintf(stderr, "mmap-pages must be a power of 2\n");
+		return 1;
+	}
+
+	fd = sys_perf_event_open(&attr, 0, -1, -1, 0);
+	if (fd < 0) {
+		fprintf(stderr, "perf_event_open: %s\n", strerror(errno));
+		return 1;
+	}
+
+	data_size = (u64)mmap_pages * page_size;
+	base = mmap(NULL, data_size + page_size, PROT_READ | PROT_WRITE,
+		    MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		fprintf(stderr, "mmap of %u pages: %s\n", mmap_pages,
+			strerror(errno));
+		close(fd);
+		return 1;
+	}
+
+	buf = mmap(NULL, BATCH_PAGES * page_size, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (buf == MAP_FAILED) {
+		fprintf(stderr, "mmap: %s\n", strerror(errno));
+		munmap(base, data_size + page_size);
+		close(fd);
+		return 1;
+	}
+
+	gettimeofday(&start, NULL);
+	ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+
+	while (stats.samples + stats.lost < nr_samples) {
+		for (i = 0; i < BATCH_PAGES; i++)
+			((volatile char *)buf)[i * page_size] = 1;
+		madvise(buf, BATCH_PAGES * page_size, MADV_DONTNEED);
+
+		ringbuf_consume(base, base + page_size, data_size, &stats);
+	}
+
+	ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+	gettimeofday(&stop, NULL);
+	timersub(&stop, &start, &diff);
+
+	munmap(buf, BATCH_PAGES * page_size);
+	munmap(base, data_size + page_size);
+	close(fd);
+
+	result_usec = diff.tv_sec * USEC_PER_SEC + diff.tv_usec;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Wrote %" PRIu64 " samples (%" PRIu64 " lost) into a %u page ring buffer\n\n",
+		       stats.samples, stats.lost, mmap_pages);
+
+		printf(" %14s: %lu.%03lu [sec]\n\n", "Total time",
+		       diff.tv_sec,
+		       (unsigned long) (diff.tv_usec / USEC_PER_MSEC));
+
+		printf(" %14lf usecs/sample\n",
+		       (double)result_usec / (double)stats.samples);
+		printf(" %14" PRIu64 " samples/sec\n",
+		       stats.samples * USEC_PER_SEC / result_usec);
+		printf(" %14lf MB/sec\n",
+		       (double)stats.bytes / (double)result_usec);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%" PRIu64 "\n", stats.samples * USEC_PER_SEC / result_usec);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	return 0;
+}
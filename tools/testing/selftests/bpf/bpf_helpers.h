@@ -82,6 +82,13 @@ static int (*bpf_perf_event_read_value)(void *map, unsigned long long flags,
 static int (*bpf_perf_prog_read_value)(void *ctx, void *buf,
 				       unsigned int buf_size) =
 	(void *) BPF_FUNC_perf_prog_read_value;
+static int (*bpf_ringbuf_output)(void *map, void *data,
+				 unsigned long long size,
+				 unsigned long long flags) =
+	(void *) BPF_FUNC_ringbuf_output;
+static unsigned long long (*bpf_ringbuf_query)(void *map,
+					       unsigned long long flags) =
+	(void *) BPF_FUNC_ringbuf_query;
 
 
 /* llvm builtin functions that eBPF C program may use to
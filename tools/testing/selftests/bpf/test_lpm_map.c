@@ -521,7 +521,75 @@ static void test_lpm_delete(void)
 	close(map_fd);
 }
 
-int main(void)
+/* Prefix length distributions loosely following the public IPv4 and IPv6
+ * routing tables: mostly /24 for IPv4 and /48 for IPv6, with a tail of
+ * shorter aggregates.
+ */
+static const __u8 lpm_perf_ipv4_plens[] = {
+	24, 24, 24, 24, 24, 24, 23, 22, 22, 21, 20, 19, 18, 17, 16, 16,
+};
+
+static const __u8 lpm_perf_ipv6_plens[] = {
+	48, 48, 48, 48, 48, 48, 48, 44, 40, 36, 32, 32, 32, 29, 64, 64,
+};
+
+static void lpm_perf_random_key(struct bpf_lpm_trie_key *key, size_t n_bits,
+				size_t prefixlen)
+{
+	size_t i, n_bytes = n_bits / 8;
+
+	for (i = 0; i < n_bytes; ++i)
+		key->data[i] = rand() & 0xff;
+
+	/* Keep IPv6 prefixes within 2000::/3 like global unicast */
+	if (n_bits == 128)
+		key->data[0] = 0x20 | (key->data[0] & 0x1f);
+
+	for (i = prefixlen; i < n_bits; ++i)
+		key->data[i / 8] &= ~(1 << (7 - i % 8));
+
+	key->prefixlen = prefixlen;
+}
+
+static void test_lpm_lookup_perf(size_t n_bits, const __u8 *plens,
+				 size_t n_entries)
+{
+	const size_t n_lookups = 1000000;
+	struct bpf_lpm_trie_key *key;
+	struct timespec start, end;
+	size_t key_size, i;
+	__u64 value = 0;
+	int map_fd;
+	double ns;
+
+	key_size = sizeof(*key) + n_bits / 8;
+	key = alloca(key_size);
+
+	map_fd = bpf_create_map(BPF_MAP_TYPE_LPM_TRIE, key_size, sizeof(value),
+				n_entries, BPF_F_NO_PREALLOC);
+	assert(map_fd >= 0);
+
+	for (i = 0; i < n_entries; ++i) {
+		lpm_perf_random_key(key, n_bits, plens[rand() % 16]);
+		value = i;
+		assert(bpf_map_update_elem(map_fd, key, &value, 0) == 0);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < n_lookups; ++i) {
+		lpm_perf_random_key(key, n_bits, n_bits);
+		bpf_map_lookup_elem(map_fd, key, &value);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	printf("test_lpm: %zu-bit trie with %zu prefixes: %.0f ns per lookup (incl. syscall)\n",
+	       n_bits, n_entries, ns / n_lookups);
+
+	close(map_fd);
+}
+
+int main(int argc, char **argv)
 {
 	struct rlimit limit  = { RLIM_INFINITY, RLIM_INFINITY };
 	int i, ret;
@@ -545,6 +613,12 @@ int main(void)
 
 	test_lpm_delete();
 
+	/* Lookup benchmark, not run by default: ./test_lpm_map --perf */
+	if (argc == 2 && !strcmp(argv[1], "--perf")) {
+		test_lpm_lookup_perf(32, lpm_perf_ipv4_plens, 100000);
+		test_lpm_lookup_perf(128, lpm_perf_ipv6_plens, 100000);
+	}
+
 	printf("test_lpm: OK\n");
 	return 0;
 }
@@ -16,6 +16,9 @@
 #include <assert.h>
 #include <stdlib.h>
 
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <sys/resource.h>
 
@@ -24,6 +27,8 @@
 #include <bpf/bpf.h>
 #include <bpf/libbpf.h>
 #include "bpf_util.h"
+#include "cgroup_helpers.h"
+#include "../../../include/linux/filter.h"
 
 static int map_flags;
 
@@ -288,6 +293,91 @@ static void test_hashmap_walk(int task, void *data)
 	close(fd);
 }
 
+static void __test_hashmap_batch(enum bpf_map_type type)
+{
+	int fd, i, err, max_entries = 10000, step = 64;
+	long long *keys, *values;
+	__u32 batch, count, total;
+	bool *visited;
+
+	/* LRU maps need some slack so that updates don't evict */
+	fd = bpf_create_map(type, sizeof(*keys), sizeof(*values),
+			    type == BPF_MAP_TYPE_LRU_HASH ?
+			    2 * max_entries : max_entries,
+			    type == BPF_MAP_TYPE_LRU_HASH ? 0 : map_flags);
+	if (fd < 0) {
+		printf("Failed to create hashmap '%s'!\n", strerror(errno));
+		exit(1);
+	}
+
+	keys = calloc(max_entries, sizeof(*keys));
+	values = calloc(max_entries, sizeof(*values));
+	visited = calloc(max_entries, sizeof(*visited));
+	assert(keys && values && visited);
+
+	for (i = 0; i < max_entries; i++) {
+		keys[i] = i;
+		values[i] = i + 1;
+	}
+
+	count = max_entries;
+	assert(bpf_map_update_batch(fd, keys, values, &count, BPF_NOEXIST) == 0);
+	assert(count == max_entries);
+
+	/* Walk the map in small chunks, resuming from the returned cursor. */
+	memset(keys, 0, max_entries * sizeof(*keys));
+	memset(values, 0, max_entries * sizeof(*values));
+	total = 0;
+	err = 0;
+	while (!err) {
+		count = step;
+		err = bpf_map_lookup_batch(fd, total ? &batch : NULL, &batch,
+					   keys + total, values + total,
+					   &count);
+		assert(!err || errno == ENOENT);
+		total += count;
+		assert(total <= max_entries);
+	}
+	assert(total == max_entries);
+
+	for (i = 0; i < max_entries; i++) {
+		assert(keys[i] >= 0 && keys[i] < max_entries);
+		assert(values[i] == keys[i] + 1);
+		assert(!visited[keys[i]]);
+		visited[keys[i]] = true;
+	}
+
+	/* Drain everything in one call. */
+	count = max_entries;
+	err = bpf_map_lookup_and_delete_batch(fd, NULL, &batch, keys, values,
+					      &count);
+	assert(err == -1 && errno == ENOENT && count == max_entries);
+	assert(bpf_map_get_next_key(fd, NULL, &keys[0]) == -1 &&
+	       errno == ENOENT);
+
+	/* Refill and delete by key. */
+	for (i = 0; i < max_entries; i++)
+		keys[i] = i;
+	count = max_entries;
+	assert(bpf_map_update_batch(fd, keys, values, &count, BPF_ANY) == 0);
+	count = max_entries;
+	assert(bpf_map_delete_batch(fd, keys, &count) == 0);
+	assert(count == max_entries);
+	assert(bpf_map_get_next_key(fd, NULL, &keys[0]) == -1 &&
+	       errno == ENOENT);
+
+	free(visited);
+	free(values);
+	free(keys);
+	close(fd);
+}
+
+static void test_hashmap_batch(int task, void *data)
+{
+	__test_hashmap_batch(BPF_MAP_TYPE_HASH);
+	__test_hashmap_batch(BPF_MAP_TYPE_LRU_HASH);
+}
+
 static void test_arraymap(int task, void *data)
 {
 	int key, next_key, fd;
@@ -439,6 +529,130 @@ static void test_arraymap_percpu_many_keys(void)
 	close(fd);
 }
 
+#define RINGBUF_CGROUP		"test-ringbuf-cgroup/"
+#define RINGBUF_SAMPLE		0x1234
+
+/* Run a device cgroup program that emits one 8 byte sample per device
+ * access, and consume the samples through the mmapped pages.
+ */
+static void test_ringbuf_output(int map_fd, unsigned long *cons,
+				unsigned long *prod, long page_size,
+				size_t data_sz)
+{
+	struct bpf_insn prog[] = {
+		BPF_ST_MEM(BPF_DW, BPF_REG_10, -8, RINGBUF_SAMPLE),
+		BPF_LD_MAP_FD(BPF_REG_1, map_fd),
+		BPF_MOV64_REG(BPF_REG_2, BPF_REG_10),
+		BPF_ALU64_IMM(BPF_ADD, BPF_REG_2, -8),
+		BPF_MOV64_IMM(BPF_REG_3, 8),
+		BPF_MOV64_IMM(BPF_REG_4, 0),
+		BPF_EMIT_CALL(BPF_FUNC_ringbuf_output),
+		BPF_MOV64_IMM(BPF_REG_0, 1),
+		BPF_EXIT_INSN(),
+	};
+	struct pollfd pfd = { .fd = map_fd, .events = POLLIN };
+	unsigned long pos, prod_pos;
+	int prog_fd, cgroup_fd, dev_fd;
+	__u32 *hdr;
+	void *data = (void *)prod + page_size;
+
+	prog_fd = bpf_load_program(BPF_PROG_TYPE_CGROUP_DEVICE, prog,
+				   sizeof(prog) / sizeof(prog[0]), "GPL", 0,
+				   NULL, 0);
+	if (prog_fd < 0) {
+		printf("Failed to load ringbuf program '%s'!\n",
+		       strerror(errno));
+		exit(1);
+	}
+
+	if (setup_cgroup_environment()) {
+		printf("Failed to set up cgroup environment\n");
+		exit(1);
+	}
+	cgroup_fd = create_and_get_cgroup(RINGBUF_CGROUP);
+	if (cgroup_fd < 0 || join_cgroup(RINGBUF_CGROUP)) {
+		printf("Failed to join test cgroup\n");
+		exit(1);
+	}
+	if (bpf_prog_attach(prog_fd, cgroup_fd, BPF_CGROUP_DEVICE, 0)) {
+		printf("Failed to attach ringbuf program '%s'!\n",
+		       strerror(errno));
+		exit(1);
+	}
+
+	/* opening a device runs the program */
+	dev_fd = open("/dev/null", O_RDONLY);
+	assert(dev_fd >= 0);
+	close(dev_fd);
+
+	/* the ring was empty, so the first record wakes up the consumer */
+	assert(poll(&pfd, 1, 1000) == 1 && (pfd.revents & POLLIN));
+
+	prod_pos = __atomic_load_n(prod, __ATOMIC_ACQUIRE);
+	assert(prod_pos >= 16 && !(prod_pos % 16));
+
+	for (pos = *cons; pos < prod_pos; pos += 16) {
+		hdr = data + (pos & (data_sz - 1));
+		assert(hdr[0] == 8);
+		assert(*(__u64 *)(hdr + 2) == RINGBUF_SAMPLE);
+	}
+	__atomic_store_n(cons, prod_pos, __ATOMIC_RELEASE);
+
+	/* everything was consumed */
+	assert(poll(&pfd, 1, 0) == 0);
+
+	bpf_prog_detach(cgroup_fd, BPF_CGROUP_DEVICE);
+	close(cgroup_fd);
+	close(prog_fd);
+	cleanup_cgroup_environment();
+}
+
+static void test_ringbuf(int task, void *data)
+{
+	long page_size = sysconf(_SC_PAGE_SIZE);
+	size_t data_sz = 4 * page_size;
+	unsigned long *cons, *prod;
+	struct pollfd pfd = {};
+	int fd;
+
+	/* size must be a power-of-2 multiple of the page size, no key/value */
+	fd = bpf_create_map(BPF_MAP_TYPE_RINGBUF, 0, 0, 3 * page_size, 0);
+	assert(fd < 0 && errno == EINVAL);
+	fd = bpf_create_map(BPF_MAP_TYPE_RINGBUF, 4, 0, data_sz, 0);
+	assert(fd < 0 && errno == EINVAL);
+
+	fd = bpf_create_map(BPF_MAP_TYPE_RINGBUF, 0, 0, data_sz, 0);
+	if (fd < 0) {
+		printf("Failed to create ringbuf '%s'!\n", strerror(errno));
+		exit(1);
+	}
+
+	/* only the consumer position page may be mapped writable */
+	cons = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	assert(cons != MAP_FAILED && *cons == 0);
+	assert(mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		    page_size) == MAP_FAILED && errno == EPERM);
+
+	/* producer page followed by the double-mapped data area */
+	prod = mmap(NULL, page_size + 2 * data_sz, PROT_READ, MAP_SHARED, fd,
+		    page_size);
+	assert(prod != MAP_FAILED && *prod == 0);
+	assert(mprotect(prod, page_size, PROT_READ | PROT_WRITE) == -1);
+	assert(mmap(NULL, 2 * page_size, PROT_READ, MAP_SHARED, fd,
+		    page_size + 2 * data_sz) == MAP_FAILED);
+
+	/* nothing was produced yet */
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	assert(poll(&pfd, 1, 0) == 0);
+
+	test_ringbuf_output(fd, cons, prod, page_size, data_sz);
+
+	munmap(prod, page_size + 2 * data_sz);
+	munmap(cons, page_size);
+	close(fd);
+}
+
 static void test_devmap(int task, void *data)
 {
 	int fd;
@@ -1093,12 +1307,15 @@ static void run_all_tests(void)
 	test_hashmap(0, NULL);
 	test_hashmap_percpu(0, NULL);
 	test_hashmap_walk(0, NULL);
+	test_hashmap_batch(0, NULL);
 
 	test_arraymap(0, NULL);
 	test_arraymap_percpu(0, NULL);
 
 	test_arraymap_percpu_many_keys();
 
+	test_ringbuf(0, NULL);
+
 	test_devmap(0, NULL);
 	test_sockmap(0, NULL);
 
@@ -22,6 +22,10 @@
  *   - PACKET_FANOUT_CBPF
  *   - PACKET_FANOUT_EBPF
  *
+ *   PACKET_FANOUT_CHASH is tested separately with three packet sockets: a
+ *   flow must land on a single socket, and stay there when another member
+ *   of the group leaves.
+ *
  * Todo:
  * - functionality: PACKET_FANOUT_FLAG_DEFRAG
  *
@@ -391,6 +395,81 @@ static int test_datapath(uint16_t typeflags, int port_off,
 	return ret;
 }
 
+static int test_chash(int port_off)
+{
+	const int num = 3, num_pkts = 5;
+	char *rings[3];
+	int fds[3], fds_udp[2], count[3];
+	int i, owner = -1, victim, other, ret = 0;
+
+	fprintf(stderr, "test: chash\n");
+
+	for (i = 0; i < num; i++) {
+		fds[i] = sock_fanout_open(PACKET_FANOUT_CHASH, 0);
+		if (fds[i] == -1) {
+			fprintf(stderr, "ERROR: failed open\n");
+			exit(1);
+		}
+		rings[i] = sock_fanout_open_ring(fds[i]);
+	}
+	pair_udp_open(fds_udp, PORT_BASE + port_off);
+
+	pair_udp_send(fds_udp, num_pkts);
+	for (i = 0; i < num; i++) {
+		count[i] = sock_fanout_read_ring(fds[i], rings[i]);
+		if (count[i] == num_pkts && owner == -1)
+			owner = i;
+		else if (count[i])
+			ret = 1;
+	}
+	fprintf(stderr, "info: count=%d,%d,%d\n", count[0], count[1], count[2]);
+	if (ret || owner == -1) {
+		fprintf(stderr, "ERROR: flow spread over sockets\n");
+		exit(1);
+	}
+
+	/* Remove a member that does not own the flow */
+	victim = (owner + 1) % num;
+	if (munmap(rings[victim], RING_NUM_FRAMES * getpagesize()) ||
+	    close(fds[victim])) {
+		fprintf(stderr, "close victim\n");
+		exit(1);
+	}
+
+	/* Maglev keeps most, but not all, flows in place when a member
+	 * leaves, so only require that the flow still lands on a single
+	 * socket and report whether it moved.
+	 */
+	pair_udp_send(fds_udp, num_pkts);
+	for (i = 0; i < num; i++) {
+		if (i == victim)
+			continue;
+		count[i] = sock_fanout_read_ring(fds[i], rings[i]);
+	}
+	fprintf(stderr, "info: count=%d,%d after removing %d\n",
+		count[(victim + 1) % num], count[(victim + 2) % num], victim);
+	other = 3 - owner - victim;
+	if (count[owner] == num_pkts && count[other] == num_pkts) {
+		fprintf(stderr, "info: flow moved to socket %d\n", other);
+	} else if (count[owner] != 2 * num_pkts || count[other]) {
+		fprintf(stderr, "ERROR: flow spread over sockets\n");
+		ret = 1;
+	}
+
+	pair_udp_close(fds_udp);
+	for (i = 0; i < num; i++) {
+		if (i == victim)
+			continue;
+		if (munmap(rings[i], RING_NUM_FRAMES * getpagesize()) ||
+		    close(fds[i])) {
+			fprintf(stderr, "close chash\n");
+			exit(1);
+		}
+	}
+
+	return ret;
+}
+
 static int set_cpuaffinity(int cpuid)
 {
 	cpu_set_t mask;
@@ -445,6 +524,8 @@ int main(int argc, char **argv)
 	ret |= test_datapath(PACKET_FANOUT_EBPF,
 			     port_off, expect_bpf[0], expect_bpf[1]);
 
+	ret |= test_chash(port_off);
+
 	set_cpuaffinity(0);
 	ret |= test_datapath(PACKET_FANOUT_CPU, port_off,
 			     expect_cpu0[0], expect_cpu0[1]);
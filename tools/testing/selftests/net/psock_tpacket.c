@@ -18,7 +18,7 @@
  *   The test currently runs for
  *   - TPACKET_V1: RX_RING, TX_RING
  *   - TPACKET_V2: RX_RING, TX_RING
- *   - TPACKET_V3: RX_RING
+ *   - TPACKET_V3: RX_RING, TX_RING (fixed and variable sized frames)
  *
  * License (GPLv2):
  *
@@ -107,6 +107,7 @@ union frame_map {
 };
 
 static unsigned int total_packets, total_bytes;
+static int tx_var_frames;
 
 static int pfsocket(int ver)
 {
@@ -378,6 +379,24 @@ static inline void *get_next_frame(struct ring *ring, int n)
 	}
 }
 
+/* With variable sized TPACKET_V3 frames, each frame's tp_next_offset
+ * points at the next one, and the kernel moves on to the next block once
+ * less than tp_frame_size is left in the current one.
+ */
+static void *get_next_var_frame(struct ring *ring, unsigned int *blk,
+				unsigned int *off, unsigned int slot)
+{
+	if (slot) {
+		*off += slot;
+		if (ring->req3.tp_block_size - *off < ring->req3.tp_frame_size) {
+			*off = 0;
+			*blk = (*blk + 1) % ring->req3.tp_block_nr;
+		}
+	}
+
+	return ring->mm_space + *blk * ring->req3.tp_block_size + *off;
+}
+
 static void walk_tx(int sock, struct ring *ring)
 {
 	struct pollfd pfd;
@@ -386,6 +405,7 @@ static void walk_tx(int sock, struct ring *ring)
 	union frame_map ppd;
 	char packet[1024];
 	unsigned int frame_num = 0, got = 0;
+	unsigned int blk = 0, off = 0, slot = 0;
 	struct sockaddr_ll ll = {
 		.sll_family = PF_PACKET,
 		.sll_halen = ETH_ALEN,
@@ -428,7 +448,13 @@ static void walk_tx(int sock, struct ring *ring)
 	create_payload(packet, &packet_len);
 
 	while (total_packets > 0) {
-		void *next = get_next_frame(ring, frame_num);
+		void *next;
+
+		if (tx_var_frames)
+			next = get_next_var_frame(ring, &blk, &off, slot);
+		else
+			next = get_next_frame(ring, frame_num);
+		slot = 0;
 
 		while (__tx_kernel_ready(next, ring->version) &&
 		       total_packets > 0) {
@@ -460,6 +486,12 @@ static void walk_tx(int sock, struct ring *ring)
 				tx->tp_snaplen = packet_len;
 				tx->tp_len = packet_len;
 				tx->tp_next_offset = 0;
+				if (tx_var_frames) {
+					slot = TPACKET_ALIGN(TPACKET3_HDRLEN -
+						sizeof(struct sockaddr_ll) +
+						packet_len);
+					tx->tp_next_offset = slot;
+				}
 
 				memcpy((uint8_t *)tx + TPACKET3_HDRLEN -
 				       sizeof(struct sockaddr_ll), packet,
@@ -816,8 +848,8 @@ static int test_tpacket(int version, int type)
 	int sock;
 	struct ring ring;
 
-	fprintf(stderr, "test: %s with %s ", tpacket_str[version],
-		type_str[type]);
+	fprintf(stderr, "test: %s with %s%s ", tpacket_str[version],
+		type_str[type], tx_var_frames ? " (variable frames)" : "");
 	fflush(stderr);
 
 	if (version == TPACKET_V1 &&
@@ -854,6 +886,10 @@ int main(void)
 	ret |= test_tpacket(TPACKET_V3, PACKET_RX_RING);
 	ret |= test_tpacket(TPACKET_V3, PACKET_TX_RING);
 
+	tx_var_frames = 1;
+	ret |= test_tpacket(TPACKET_V3, PACKET_TX_RING);
+	tx_var_frames = 0;
+
 	if (ret)
 		return 1;
 
@@ -0,0 +1,385 @@
+// SPDX-License-Identifier: GPL-2.0
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/tls.h>
+#include <linux/tcp.h>
+#include <linux/socket.h>
+
+#include <sys/types.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+
+#include "../kselftest_harness.h"
+
+#define TLS_PAYLOAD_MAX_LEN 16384
+#define SOL_TLS 282
+
+#ifndef TLS_RX
+#define TLS_RX			2
+#define TLS_GET_RECORD_TYPE	2
+#endif
+
+#define BENCH_BYTES	(256 << 20)
+
+FIXTURE(tls)
+{
+	int fd, cfd;
+	bool notls;
+};
+
+FIXTURE_SETUP(tls)
+{
+	struct tls12_crypto_info_aes_gcm_128 tls12;
+	struct sockaddr_in addr;
+	socklen_t len;
+	int sfd, ret;
+
+	self->notls = false;
+	len = sizeof(addr);
+
+	memset(&tls12, 0, sizeof(tls12));
+	tls12.info.version = TLS_1_2_VERSION;
+	tls12.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = 0;
+
+	self->fd = socket(AF_INET, SOCK_STREAM, 0);
+	sfd = socket(AF_INET, SOCK_STREAM, 0);
+
+	ret = bind(sfd, (struct sockaddr *)&addr, sizeof(addr));
+	ASSERT_EQ(ret, 0);
+	ret = listen(sfd, 10);
+	ASSERT_EQ(ret, 0);
+
+	ret = getsockname(sfd, (struct sockaddr *)&addr, &len);
+	ASSERT_EQ(ret, 0);
+
+	ret = connect(self->fd, (struct sockaddr *)&addr, sizeof(addr));
+	ASSERT_EQ(ret, 0);
+
+	ret = setsockopt(self->fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls"));
+	if (ret != 0) {
+		self->notls = true;
+		printf("Failure setting TCP_ULP, testing without tls\n");
+	}
+
+	if (!self->notls) {
+		ret = setsockopt(self->fd, SOL_TLS, TLS_TX, &tls12,
+				 sizeof(tls12));
+		ASSERT_EQ(ret, 0);
+	}
+
+	self->cfd = accept(sfd, (struct sockaddr *)&addr, &len);
+	ASSERT_GE(self->cfd, 0);
+
+	if (!self->notls) {
+		ret = setsockopt(self->cfd, IPPROTO_TCP, TCP_ULP, "tls",
+				 sizeof("tls"));
+		ASSERT_EQ(ret, 0);
+
+		ret = setsockopt(self->cfd, SOL_TLS, TLS_RX, &tls12,
+				 sizeof(tls12));
+		ASSERT_EQ(ret, 0);
+	}
+
+	close(sfd);
+}
+
+FIXTURE_TEARDOWN(tls)
+{
+	close(self->fd);
+	close(self->cfd);
+}
+
+TEST_F(tls, send_then_recv)
+{
+	char const *test_str = "test_read";
+	int send_len = 10;
+	char buf[10];
+
+	ASSERT_EQ(send(self->fd, test_str, send_len, 0), send_len);
+	ASSERT_EQ(recv(self->cfd, buf, send_len, MSG_WAITALL), send_len);
+	EXPECT_EQ(memcmp(buf, test_str, send_len), 0);
+}
+
+TEST_F(tls, multiple_records)
+{
+	unsigned int send_len = TLS_PAYLOAD_MAX_LEN * 4 + 17;
+	char *mem_send = malloc(send_len);
+	char *mem_recv = malloc(send_len);
+	unsigned int i;
+
+	ASSERT_NE(mem_send, NULL);
+	ASSERT_NE(mem_recv, NULL);
+	for (i = 0; i < send_len; i++)
+		mem_send[i] = i * 7;
+
+	ASSERT_EQ(send(self->fd, mem_send, send_len, 0), send_len);
+	ASSERT_EQ(recv(self->cfd, mem_recv, send_len, MSG_WAITALL), send_len);
+	EXPECT_EQ(memcmp(mem_send, mem_recv, send_len), 0);
+
+	free(mem_send);
+	free(mem_recv);
+}
+
+TEST_F(tls, recv_partial)
+{
+	char const *test_str = "test_read_partial";
+	char const *test_str_first = "test_read";
+	char const *test_str_second = "_partial";
+	int send_len = strlen(test_str) + 1;
+	char recv_mem[18];
+
+	memset(recv_mem, 0, sizeof(recv_mem));
+	ASSERT_EQ(send(self->fd, test_str, send_len, 0), send_len);
+	ASSERT_EQ(recv(self->cfd, recv_mem, strlen(test_str_first),
+		       MSG_WAITALL), strlen(test_str_first));
+	EXPECT_EQ(memcmp(test_str_first, recv_mem, strlen(test_str_first)), 0);
+	memset(recv_mem, 0, sizeof(recv_mem));
+	ASSERT_EQ(recv(self->cfd, recv_mem, strlen(test_str_second),
+		       MSG_WAITALL), strlen(test_str_second));
+	EXPECT_EQ(memcmp(test_str_second, recv_mem, strlen(test_str_second)),
+		  0);
+}
+
+TEST_F(tls, recv_short)
+{
+	struct timeval tv = { .tv_sec = 2 };
+	char const *test_str = "test_read";
+	int send_len = 10;
+	struct timespec start, end;
+	char buf[16384];
+
+	/* A plain recv() into a larger buffer returns what is there */
+	ASSERT_EQ(setsockopt(self->cfd, SOL_SOCKET, SO_RCVTIMEO, &tv,
+			     sizeof(tv)), 0);
+	ASSERT_EQ(send(self->fd, test_str, send_len, 0), send_len);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ASSERT_EQ(recv(self->cfd, buf, sizeof(buf), 0), send_len);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	EXPECT_EQ(memcmp(buf, test_str, send_len), 0);
+	/* Well below SO_RCVTIMEO, so it did not wait for more data */
+	EXPECT_LT((end.tv_sec - start.tv_sec) * 1000 +
+		  (end.tv_nsec - start.tv_nsec) / 1000000, 1000);
+}
+
+TEST_F(tls, recv_peek)
+{
+	char const *test_str = "test_read_peek";
+	int send_len = strlen(test_str) + 1;
+	char buf[15];
+
+	ASSERT_EQ(send(self->fd, test_str, send_len, 0), send_len);
+	ASSERT_EQ(recv(self->cfd, buf, send_len, MSG_PEEK), send_len);
+	EXPECT_EQ(memcmp(test_str, buf, send_len), 0);
+	memset(buf, 0, sizeof(buf));
+	ASSERT_EQ(recv(self->cfd, buf, send_len, 0), send_len);
+	EXPECT_EQ(memcmp(test_str, buf, send_len), 0);
+}
+
+TEST_F(tls, recv_nonblock)
+{
+	char buf[4096];
+
+	EXPECT_EQ(recv(self->cfd, buf, sizeof(buf), MSG_DONTWAIT), -1);
+	EXPECT_EQ(errno, EAGAIN);
+}
+
+TEST_F(tls, poll_wait)
+{
+	char const *test_str = "test_poll_wait";
+	int send_len = strlen(test_str) + 1;
+	struct pollfd fd = { 0, 0, 0 };
+	char recv_mem[15];
+
+	fd.fd = self->cfd;
+	fd.events = POLLIN;
+	EXPECT_EQ(poll(&fd, 1, 20), 0);
+
+	ASSERT_EQ(send(self->fd, test_str, send_len, 0), send_len);
+	EXPECT_EQ(poll(&fd, 1, 20), 1);
+	EXPECT_EQ(fd.revents & POLLIN, POLLIN);
+	EXPECT_EQ(recv(self->cfd, recv_mem, send_len, MSG_WAITALL), send_len);
+}
+
+TEST_F(tls, splice_to_pipe)
+{
+	int send_len = TLS_PAYLOAD_MAX_LEN;
+	char mem_send[TLS_PAYLOAD_MAX_LEN];
+	char mem_recv[TLS_PAYLOAD_MAX_LEN];
+	int p[2];
+
+	ASSERT_GE(pipe(p), 0);
+	memset(mem_send, 0x5a, sizeof(mem_send));
+	EXPECT_EQ(send(self->fd, mem_send, send_len, 0), send_len);
+	EXPECT_EQ(splice(self->cfd, NULL, p[1], NULL, send_len, 0), send_len);
+	EXPECT_EQ(read(p[0], mem_recv, send_len), send_len);
+	EXPECT_EQ(memcmp(mem_send, mem_recv, send_len), 0);
+	close(p[0]);
+	close(p[1]);
+}
+
+TEST_F(tls, control_msg)
+{
+	char cbuf[CMSG_SPACE(sizeof(char))];
+	char const *test_str = "test_read";
+	struct cmsghdr *cmsg;
+	unsigned char record_type = 100;
+	int cmsg_len = sizeof(char);
+	int send_len = 10;
+	struct msghdr msg;
+	struct iovec vec;
+	char buf[10];
+
+	if (self->notls)
+		return;
+
+	vec.iov_base = (char *)test_str;
+	vec.iov_len = send_len;
+	memset(&msg, 0, sizeof(struct msghdr));
+	msg.msg_iov = &vec;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_TLS;
+	/* test sending non-record types. */
+	cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+	cmsg->cmsg_len = CMSG_LEN(cmsg_len);
+	*CMSG_DATA(cmsg) = record_type;
+	msg.msg_controllen = cmsg->cmsg_len;
+
+	EXPECT_EQ(sendmsg(self->fd, &msg, 0), send_len);
+	/* Should fail because we didn't provide a control message */
+	EXPECT_EQ(recv(self->cfd, buf, send_len, 0), -1);
+
+	vec.iov_base = buf;
+	msg.msg_controllen = sizeof(cbuf);
+	EXPECT_EQ(recvmsg(self->cfd, &msg, 0), send_len);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	EXPECT_NE(cmsg, NULL);
+	EXPECT_EQ(cmsg->cmsg_level, SOL_TLS);
+	EXPECT_EQ(cmsg->cmsg_type, TLS_GET_RECORD_TYPE);
+	record_type = *((unsigned char *)CMSG_DATA(cmsg));
+	EXPECT_EQ(record_type, 100);
+	EXPECT_EQ(memcmp(buf, test_str, send_len), 0);
+}
+
+TEST_F(tls, cork)
+{
+	char const *test_str = "corked_";
+	int send_len = strlen(test_str);
+	char buf[7 * 8];
+	int one = 1, zero = 0;
+	int i;
+
+	ASSERT_EQ(setsockopt(self->fd, IPPROTO_TCP, TCP_CORK, &one,
+			     sizeof(one)), 0);
+	for (i = 0; i < 8; i++)
+		ASSERT_EQ(send(self->fd, test_str, send_len, 0), send_len);
+
+	/* Nothing goes out until the socket is uncorked */
+	EXPECT_EQ(recv(self->cfd, buf, sizeof(buf), MSG_DONTWAIT), -1);
+	EXPECT_EQ(errno, EAGAIN);
+
+	ASSERT_EQ(setsockopt(self->fd, IPPROTO_TCP, TCP_CORK, &zero,
+			     sizeof(zero)), 0);
+	ASSERT_EQ(recv(self->cfd, buf, sizeof(buf), MSG_WAITALL), sizeof(buf));
+	for (i = 0; i < 8; i++)
+		EXPECT_EQ(memcmp(buf + i * send_len, test_str, send_len), 0);
+}
+
+TEST_F(tls, sendfile)
+{
+	unsigned int send_len = TLS_PAYLOAD_MAX_LEN * 8 + 100;
+	char *mem_send = malloc(send_len);
+	char *mem_recv = malloc(send_len);
+	char filename[] = "/tmp/tls_sendfile_XXXXXX";
+	unsigned int i;
+	int filefd;
+
+	ASSERT_NE(mem_send, NULL);
+	ASSERT_NE(mem_recv, NULL);
+	for (i = 0; i < send_len; i++)
+		mem_send[i] = i * 13;
+
+	filefd = mkstemp(filename);
+	ASSERT_GE(filefd, 0);
+	unlink(filename);
+	ASSERT_EQ(write(filefd, mem_send, send_len), send_len);
+	ASSERT_EQ(lseek(filefd, 0, SEEK_SET), 0);
+
+	EXPECT_EQ(sendfile(self->fd, filefd, NULL, send_len), send_len);
+	ASSERT_EQ(recv(self->cfd, mem_recv, send_len, MSG_WAITALL), send_len);
+	EXPECT_EQ(memcmp(mem_send, mem_recv, send_len), 0);
+
+	close(filefd);
+	free(mem_send);
+	free(mem_recv);
+}
+
+/*
+ * Not a pass/fail test: reports the throughput of encrypting in the
+ * sender's kernel and decrypting in the receiver's kernel over loopback.
+ * Compare with a userspace TLS library moving the same data, e.g.
+ * "openssl speed -evp aes-128-gcm" plus the plain loopback rate.
+ */
+TEST_F(tls, loopback_throughput)
+{
+	size_t chunk = TLS_PAYLOAD_MAX_LEN * 4;
+	char *mem = malloc(chunk);
+	struct timespec start, end;
+	size_t done = 0;
+	double secs;
+	pid_t pid;
+
+	ASSERT_NE(mem, NULL);
+	memset(mem, 0xa5, chunk);
+
+	pid = fork();
+	ASSERT_GE(pid, 0);
+	if (!pid) {
+		while (done < BENCH_BYTES) {
+			ssize_t ret = send(self->fd, mem, chunk, 0);
+
+			if (ret <= 0)
+				_exit(1);
+			done += ret;
+		}
+		_exit(0);
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	while (done < BENCH_BYTES) {
+		ssize_t ret = recv(self->cfd, mem, chunk, 0);
+
+		ASSERT_GT(ret, 0);
+		done += ret;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	secs = (end.tv_sec - start.tv_sec) +
+	       (end.tv_nsec - start.tv_nsec) / 1e9;
+	fprintf(stderr, "%s: %zu MB in %.3f s, %.1f MB/s\n",
+		self->notls ? "plain TCP" : "kTLS TX+RX", done >> 20, secs,
+		(done >> 20) / secs);
+	free(mem);
+}
+
+TEST_HARNESS_MAIN
@@ -0,0 +1,305 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Exercise the AF_UNIX in-flight fd garbage collector.
+ *
+ * Latency: one process passes batches of AF_UNIX sockets over a
+ * socketpair to a receiver that closes them again, while a second
+ * process keeps releasing AF_UNIX sockets, each of which kicks the
+ * collector. Report sendmsg() latency of the passing side.
+ *
+ * Collection: create sockets that hold a reference to themselves in
+ * their own receive queue, close them, and check that they disappear
+ * from /proc/net/unix.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <error.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NR_POOL		16
+#define NR_CYCLES	64
+#define MAX_SAMPLES	(1 << 20)
+
+static int cfg_duration_sec = 2;
+static int cfg_max_usec;
+static int cfg_nr_fds = 8;
+
+static uint64_t now_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void send_fds(int fd, const int *fds, int nr)
+{
+	char cbuf[CMSG_SPACE(sizeof(int) * NR_POOL)] = {0};
+	struct msghdr msg = {0};
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char data = 'a';
+
+	iov.iov_base = &data;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = CMSG_SPACE(sizeof(int) * nr);
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nr);
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nr);
+
+	if (sendmsg(fd, &msg, 0) != 1)
+		error(1, errno, "sendmsg");
+}
+
+static void do_recv(int fd)
+{
+	char cbuf[CMSG_SPACE(sizeof(int) * NR_POOL)];
+	struct msghdr msg = {0};
+	struct cmsghdr *cmsg;
+	struct iovec iov;
+	char data;
+	int i, nr;
+
+	iov.iov_base = &data;
+	iov.iov_len = 1;
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	while (1) {
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
+
+		if (recvmsg(fd, &msg, 0) <= 0)
+			exit(0);
+
+		for (cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+		     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+			if (cmsg->cmsg_level != SOL_SOCKET ||
+			    cmsg->cmsg_type != SCM_RIGHTS)
+				continue;
+			nr = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			for (i = 0; i < nr; i++)
+				close(((int *)CMSG_DATA(cmsg))[i]);
+		}
+	}
+}
+
+/* Every release of an AF_UNIX socket while others are in flight
+ * triggers the collector. Keep one in-flight socket of our own so
+ * that this holds even when the passing side is idle.
+ */
+static void do_churn(void)
+{
+	int pair[2], held[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, held))
+		error(1, errno, "socketpair");
+	send_fds(held[0], &held[0], 1);
+
+	while (1) {
+		if (socketpair(AF_UNIX, SOCK_DGRAM, 0, pair))
+			error(1, errno, "socketpair");
+		close(pair[0]);
+		close(pair[1]);
+	}
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int test_latency(void)
+{
+	int pair[2], pool[NR_POOL];
+	pid_t receiver, churn;
+	uint64_t *samples, start, end, total = 0;
+	unsigned long nr = 0;
+	int i, ret = 0;
+
+	samples = calloc(MAX_SAMPLES, sizeof(*samples));
+	if (!samples)
+		error(1, ENOMEM, "calloc");
+
+	for (i = 0; i < NR_POOL; i += 2)
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, pool + i))
+			error(1, errno, "socketpair");
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair))
+		error(1, errno, "socketpair");
+
+	receiver = fork();
+	if (receiver == -1)
+		error(1, errno, "fork");
+	if (!receiver) {
+		close(pair[0]);
+		do_recv(pair[1]);
+	}
+	close(pair[1]);
+
+	churn = fork();
+	if (churn == -1)
+		error(1, errno, "fork");
+	if (!churn)
+		do_churn();
+
+	end = now_nsec() + cfg_duration_sec * 1000000000ULL;
+	while (nr < MAX_SAMPLES) {
+		start = now_nsec();
+		if (start > end)
+			break;
+		send_fds(pair[0], pool, cfg_nr_fds);
+		samples[nr] = now_nsec() - start;
+		total += samples[nr++];
+	}
+
+	kill(churn, SIGKILL);
+	close(pair[0]);
+	waitpid(churn, NULL, 0);
+	waitpid(receiver, NULL, 0);
+	for (i = 0; i < NR_POOL; i++)
+		close(pool[i]);
+
+	if (!nr)
+		error(1, 0, "no samples");
+	qsort(samples, nr, sizeof(*samples), cmp_u64);
+
+	fprintf(stderr, "sendmsg of %d sockets: %lu calls, avg %lu us, p50 %lu us, p99 %lu us, max %lu us\n",
+		cfg_nr_fds, nr,
+		(unsigned long)(total / nr / 1000),
+		(unsigned long)(samples[nr / 2] / 1000),
+		(unsigned long)(samples[nr * 99 / 100] / 1000),
+		(unsigned long)(samples[nr - 1] / 1000));
+
+	if (cfg_max_usec && samples[nr * 99 / 100] / 1000 > cfg_max_usec) {
+		fprintf(stderr, "ERROR: p99 latency above %d us\n", cfg_max_usec);
+		ret = 1;
+	}
+
+	free(samples);
+	return ret;
+}
+
+/* Return how many of @inodes are still listed in /proc/net/unix */
+static int count_sockets(const ino_t *inodes, int nr)
+{
+	unsigned long ino;
+	char line[512];
+	int i, found = 0;
+	FILE *f;
+
+	f = fopen("/proc/net/unix", "r");
+	if (!f)
+		error(1, errno, "open /proc/net/unix");
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%*s %*s %*s %*s %*s %*s %lu", &ino) != 1)
+			continue;
+		for (i = 0; i < nr; i++)
+			if (inodes[i] == ino)
+				found++;
+	}
+
+	fclose(f);
+	return found;
+}
+
+static int test_collect(void)
+{
+	ino_t inodes[NR_CYCLES];
+	int pair[2], i, left;
+	struct stat st;
+
+	for (i = 0; i < NR_CYCLES; i++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair))
+			error(1, errno, "socketpair");
+		if (fstat(pair[0], &st))
+			error(1, errno, "fstat");
+		inodes[i] = st.st_ino;
+
+		/* pair[0] ends up on its own receive queue */
+		send_fds(pair[1], &pair[0], 1);
+		close(pair[0]);
+		close(pair[1]);
+	}
+
+	/* Releasing a socket kicks the collector, which runs async */
+	for (i = 0; i < 100; i++) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair))
+			error(1, errno, "socketpair");
+		close(pair[0]);
+		close(pair[1]);
+
+		left = count_sockets(inodes, NR_CYCLES);
+		if (!left)
+			break;
+		usleep(10 * 1000);
+	}
+
+	fprintf(stderr, "collect: %d of %d cycles left\n", left, NR_CYCLES);
+	if (left) {
+		fprintf(stderr, "ERROR: cycles not collected\n");
+		return 1;
+	}
+	return 0;
+}
+
+static void parse_opts(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "m:n:t:")) != -1) {
+		switch (c) {
+		case 'm':
+			cfg_max_usec = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			cfg_nr_fds = strtoul(optarg, NULL, 0);
+			if (cfg_nr_fds < 1 || cfg_nr_fds > NR_POOL)
+				error(1, 0, "fds per message: 1-%d", NR_POOL);
+			break;
+		case 't':
+			cfg_duration_sec = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			error(1, 0, "usage: %s [-m max p99 usec] [-n fds per message] [-t seconds]",
+			      argv[0]);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int ret;
+
+	parse_opts(argc, argv);
+
+	ret = test_latency();
+	ret |= test_collect();
+
+	if (ret)
+		return 1;
+
+	fprintf(stderr, "OK. All tests passed\n");
+	return 0;
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Benchmark the kernel's copy_from_user() and copy_to_user() through a
+ * pipe: every write() copies from the user buffer into the pipe, every
+ * read() copies it back out. Sizes go from 16 bytes to 1MB, at a few
+ * source/destination misalignments.
+ */
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_SIZE	(1UL << 20)
+#define BYTES_PER_RUN	(256UL << 20)
+
+static unsigned long long now_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	static const int offsets[] = { 0, 1, 7, 8, 15 };
+	unsigned long long start, ns;
+	unsigned long size, iters, i;
+	char *wbuf, *rbuf;
+	int fds[2], o;
+
+	if (pipe(fds)) {
+		perror("pipe");
+		return 1;
+	}
+	if (fcntl(fds[1], F_SETPIPE_SZ, MAX_SIZE) < 0) {
+		perror("F_SETPIPE_SZ");
+		return 1;
+	}
+
+	if (posix_memalign((void **)&wbuf, 4096, MAX_SIZE + 64) ||
+	    posix_memalign((void **)&rbuf, 4096, MAX_SIZE + 64)) {
+		perror("posix_memalign");
+		return 1;
+	}
+	memset(wbuf, 0x5a, MAX_SIZE + 64);
+	memset(rbuf, 0, MAX_SIZE + 64);
+
+	printf("%10s %6s %12s\n", "size", "offset", "MB/s");
+
+	for (size = 16; size <= MAX_SIZE; size *= 4) {
+		iters = BYTES_PER_RUN / size;
+		if (iters > 1000000)
+			iters = 1000000;
+
+		for (o = 0; o < sizeof(offsets) / sizeof(offsets[0]); o++) {
+			char *w = wbuf + offsets[o];
+			char *r = rbuf + (offsets[o] ? 64 - offsets[o] : 0);
+
+			start = now_nsec();
+			for (i = 0; i < iters; i++) {
+				if (write(fds[1], w, size) != size ||
+				    read(fds[0], r, size) != size) {
+					perror("pipe I/O");
+					return 1;
+				}
+			}
+			ns = now_nsec() - start;
+
+			/* Each iteration copies size bytes in and out */
+			printf("%10lu %6d %12.1f\n", size, offsets[o],
+			       2.0 * size * iters * 1000.0 / ns);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Measure the cost of mprotect() and munmap() on populated ranges from
+ * 1MB up to the given maximum, which is dominated by TLB invalidation
+ * for the larger sizes.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#define MB (1UL << 20)
+#define PAGE_SIZE sysconf(_SC_PAGESIZE)
+
+static unsigned long long now_nsec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static char *populate(unsigned long size, int thp)
+{
+	unsigned long i;
+	char *p;
+
+	p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		exit(1);
+	}
+
+	if (thp == 1)
+		madvise(p, size, MADV_HUGEPAGE);
+	else if (thp == 0)
+		madvise(p, size, MADV_NOHUGEPAGE);
+
+	for (i = 0; i < size; i += PAGE_SIZE)
+		p[i] = 1;
+
+	return p;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long size, max_size = 1024 * MB;
+	unsigned long long t0, t1, t2, prot_ns, unmap_ns;
+	int i, opt, thp = -1, repeats = 4;
+	char *p;
+
+	while ((opt = getopt(argc, argv, "m:r:tT")) != -1) {
+		switch (opt) {
+		case 'm':
+			max_size = atoi(optarg) * MB;
+			break;
+		case 'r':
+			repeats = atoi(optarg);
+			break;
+		case 't':
+			thp = 1;
+			break;
+		case 'T':
+			thp = 0;
+			break;
+		default:
+			return -1;
+		}
+	}
+
+	printf("%10s %16s %16s\n", "size (MB)", "mprotect (usec)",
+	       "munmap (usec)");
+
+	for (size = MB; size <= max_size; size *= 4) {
+		prot_ns = unmap_ns = 0;
+
+		for (i = 0; i < repeats; i++) {
+			p = populate(size, thp);
+
+			t0 = now_nsec();
+			if (mprotect(p, size, PROT_READ)) {
+				perror("mprotect");
+				exit(1);
+			}
+			t1 = now_nsec();
+			munmap(p, size);
+			t2 = now_nsec();
+
+			prot_ns += t1 - t0;
+			unmap_ns += t2 - t1;
+		}
+
+		printf("%10lu %16llu %16llu\n", size / MB,
+		       prot_ns / repeats / 1000, unmap_ns / repeats / 1000);
+	}
+
+	return 0;
+}